@@ -0,0 +1,78 @@
+#ifndef AMP_GATE_HPP
+#define AMP_GATE_HPP
+
+#include <Arduino.h>
+#include <driver/i2s.h>
+#include "Clock.hpp"
+
+
+/*
+ * Shuts the MAX98357A down through its SD pin once the output stayed below the silence threshold for the
+ * hold time, optionally stopping the I2S clocks as well. The gate opens again on the first block above the
+ * threshold; woke() tells the stream to output its pre-roll block first so the amplifier has settled before
+ * the transient arrives.
+ */
+class AmpGate {
+public:
+    explicit AmpGate(uint8_t pin, int32_t threshold = 8, uint32_t holdMillis = 3000, bool stopClock = false)
+            : pin(pin), threshold(threshold), holdMillis(holdMillis), stopClock(stopClock) {}
+
+    void begin() {
+        pinMode(pin, OUTPUT);
+        digitalWrite(pin, HIGH);
+        enabled = true;
+        lastSound = changed = Clock::millis();
+    }
+
+    // Feeds the peak of the next output block, returns false while the amplifier is shut down
+    bool update(int32_t peak, uint32_t now) {
+        if (peak > threshold) {
+            lastSound = now;
+            if (!enabled) setEnabled(true, now);
+        } else if (enabled && now - lastSound >= holdMillis) {
+            setEnabled(false, now);
+        }
+        return enabled;
+    }
+
+    // Whether the amplifier was enabled since the last call
+    bool woke() {
+        const auto value = wakeup;
+        wakeup = false;
+        return value;
+    }
+
+    bool isEnabled() const { return enabled; }
+
+    // Total time the amplifier spent shut down
+    uint32_t gatedMillis(uint32_t now) const { return gated + (enabled ? 0 : now - changed); }
+
+private:
+    void setEnabled(bool value, uint32_t now) {
+        if (!value) {
+            if (stopClock) i2s_stop(I2S_NUM_0);
+            digitalWrite(pin, LOW);
+        } else {
+            gated += now - changed;
+            if (stopClock) i2s_start(I2S_NUM_0);
+            digitalWrite(pin, HIGH);
+            wakeup = true;
+        }
+        log_d("Amplifier %s", value ? "enabled" : "shut down");
+        enabled = value;
+        changed = now;
+    }
+
+    uint8_t pin;
+    int32_t threshold;
+    uint32_t holdMillis;
+    bool stopClock;
+    bool enabled = true;
+    bool wakeup = false;
+    uint32_t lastSound = 0;
+    uint32_t changed = 0;
+    uint32_t gated = 0;
+};
+
+
+#endif //AMP_GATE_HPP
@@ -0,0 +1,382 @@
+#ifndef APP_HPP
+#define APP_HPP
+
+#include <Arduino.h>
+#include <cmath>
+#include <cstring>
+#include <driver/i2s.h>
+#include <esp_a2dp_api.h>
+#include <esp_gap_bt_api.h>
+#include <esp_sleep.h>
+#include "AmpGate.hpp"
+#include "AudioChain.hpp"
+#include "BatteryAdc.hpp"
+#include "BatteryProtection.hpp"
+#include "BlockPool.hpp"
+#include "Button.hpp"
+#include "Clock.hpp"
+#include "HealthMonitor.hpp"
+#include "LinkMonitor.hpp"
+#include "Metadata.hpp"
+#include "Oscillator.hpp"
+#include "PairingController.hpp"
+#include "PeerList.hpp"
+#include "PipelineStream.hpp"
+#include "PowerGovernor.hpp"
+#include "Settings.hpp"
+
+
+/*
+ * The speaker's glue between its modules: battery measurement and the power policy, low battery warning
+ * and shutdown, pairing, source switching, the buttons, the jitter buffer depth and the status log. The
+ * firmware and the host simulation in test/test_simulation both run this class, with different edges:
+ *
+ *  - Sink, the Bluetooth A2DP sink, constructed with the stream it writes PCM to. It needs the methods of
+ *    ESP32-A2DP's BluetoothA2DPSink that the glue calls: volume, playback control, connect_to, disconnect,
+ *    discoverability, the jitter buffer prefetch and end().
+ *  - Network, the Wi-Fi station for updates: begin(ssid, password) and connected().
+ *  - Firmware, the OTA updater: pull(url) installs an image, confirm(now, validMs) keeps it once it ran.
+ *
+ * Calls into the Bluetooth stack's own setup, the I2S driver configuration, the task layout and the console
+ * stay in main.cpp, which forwards the sink's callbacks to the on...() methods. The modules are public so
+ * both sides can wire and inspect them.
+ */
+template<typename Sink, typename Network, typename Firmware>
+class App {
+public:
+    using Output = PipelineStream<AudioChain, OutputSample>;
+
+    struct Board {
+        uint8_t amp;      /* Amplifier shutdown (SD_MODE) */
+        uint8_t battery;  /* Battery voltage measurement */
+        float divider;    /* Nominal battery voltage divider factor */
+        uint8_t left, right, center;
+    };
+
+    static constexpr float DSP_BUDGET_NS = 1000.0f;      /* Maximum processing cost per sample */
+    static constexpr uint16_t PCM_BLOCKS = 8;             /* Blocks preallocated for the audio path */
+    static constexpr uint32_t LOOP_DEADLINE_MS = 250;     /* Longest tolerated loop iteration */
+    static constexpr uint32_t AUDIO_DEADLINE_MS = 100;    /* Longest tolerated gap between blocks while streaming */
+    static constexpr uint32_t PAIRING_WINDOW_MS = 120000; /* Discoverable window of the pairing mode */
+    static constexpr uint32_t SWITCH_TIMEOUT_MS = 10000;  /* Give up a source switch not connected by then */
+    static constexpr uint32_t WIFI_TIMEOUT_MS = 20000;    /* Give up connecting to Wi-Fi for an update */
+    static constexpr uint32_t OTA_VALID_MS = 30000;       /* Uptime after which an updated firmware is kept */
+    static constexpr uint32_t STATUS_MS = 2000;           /* Period of the status log */
+    static constexpr float SHUTDOWN_FADE_MS = 1000.0f;    /* Fade out before the low battery shutdown */
+    static constexpr dsp::Tone LOW_BATTERY_CUE[] = {{880, 150}, {0, 80}, {660, 150}, {0, 80}, {440, 300}};
+
+    App(audio_tools::AudioStream &out, const Board &board) : board(board), out(out) {}
+
+    // Everything up to starting the sink, which main.cpp configures and starts before start()
+    void setup() {
+        settings.load();
+        peers.load();
+        pinMode(board.battery, INPUT);
+        batteryAdc.begin();
+#ifdef BATTERY_CALIBRATION_MV
+        batteryAdc.calibrate(BATTERY_CALIBRATION_MV);
+#endif
+        left.setup();
+        right.setup();
+        center.setup();
+        center.setDoublePress([this] { switchPeer(); });
+        blocks.begin();
+        amp.begin();
+        processed.setGate(amp);
+        processed.setOutputPort(I2S_NUM_0);
+        loopHealth = health.add("loop", LOOP_DEADLINE_MS);
+        audioHealth = health.add("audio", AUDIO_DEADLINE_MS, [] {
+            i2s_stop(I2S_NUM_0);
+            i2s_zero_dma_buffer(I2S_NUM_0);
+            i2s_start(I2S_NUM_0);
+        });
+        processed.setMonitor(health, audioHealth);
+        configureChain(chain);
+        processed.setBudget(DSP_BUDGET_NS);
+    }
+
+    // Once the sink runs: opens pairing if no source is known yet and restores the volume
+    void start() {
+        pairing.begin(peers.size() > 0, Clock::millis());
+        setVolume(settings.volume);
+    }
+
+    void loop() {
+        const auto now = Clock::millis();
+        health.beat(loopHealth);
+        if (measureBattery()) {
+            if (governor.update(batteryVoltage)) applyPowerPolicy();
+            protection.update(batteryVoltage, now);
+        }
+        protection.loop(now);
+        pairing.loop(now);
+        if (linkMonitor.update(processed.getMetrics().late, now)) applyLinkDepth();
+        processed.pump();
+        firmware.confirm(now, OTA_VALID_MS);
+        if (switchStart && now - switchStart > SWITCH_TIMEOUT_MS) {
+            log_w("Switching to " ESP_BD_ADDR_STR " timed out", ESP_BD_ADDR_HEX(switchTarget));
+            switchPending = false;
+            switchStart = 0;
+        }
+
+        left.loop();
+        right.loop();
+        center.loop();
+
+        if (now - lastStatus > STATUS_MS) {
+            lastStatus = now;
+            logStatus(now);
+        }
+    }
+
+    /*
+     * Stops Bluetooth, joins the network and installs the image at the URL, then restarts into whichever
+     * firmware is valid. Blocks for the whole download, which can take minutes. Neither the loop nor the
+     * audio path beats meanwhile and pump() no longer idles the audio entry, so both are idled here or the
+     * monitor would report them and run the I2S recovery in the middle of the download.
+     */
+    void update(const char *ssid, const char *password, const char *url) {
+        log_i("Stopping Bluetooth and connecting to %s for the update", ssid);
+        health.idle(loopHealth);
+        health.idle(audioHealth);
+        sink.end();
+        // A block still in flight while the sink stopped may have beaten again
+        health.idle(audioHealth);
+        network.begin(ssid, password);
+        const auto start = Clock::millis();
+        while (!network.connected() && Clock::millis() - start < WIFI_TIMEOUT_MS) delay(100);
+        if (!network.connected()) {
+            log_e("Connecting to %s failed", ssid);
+        } else if (firmware.pull(url)) {
+            log_i("Update installed");
+        }
+        log_i("Restarting");
+        Serial.flush();
+        ESP.restart();
+    }
+
+    void setVolume(int volume) {
+        meta.onVolume(volume);
+        if (sink.get_volume() != meta.volume) sink.set_volume(meta.volume);
+        chain.get<dsp::Volume>().setVolume(meta.volume);
+    }
+
+    void onConnectionState(esp_a2d_connection_state_t state) {
+        switch (state) {
+            case ESP_A2D_CONNECTION_STATE_CONNECTED: {
+                log_i("A2DP connected");
+                if (pairing.onConnected(Clock::millis())) {
+                    log_i("Paired in %lu ms", pairing.getMetrics().lastPairingMillis);
+                }
+                if (const auto peer = sink.get_current_peer_address()) peers.remember(*peer);
+                if (switchStart) {
+                    log_i("Switched to " ESP_BD_ADDR_STR " in %lu ms", ESP_BD_ADDR_HEX(switchTarget),
+                          Clock::millis() - switchStart);
+                    switchStart = 0;
+                }
+                // TODO: Play connected sound
+                break;
+            }
+            case ESP_A2D_CONNECTION_STATE_DISCONNECTED: {
+                log_w("A2DP disconnected");
+                pairing.onDisconnected();
+                if (switchPending) {
+                    switchPending = false;
+                    sink.connect_to(switchTarget);
+                }
+                // TODO: Play disconnected sound
+                break;
+            }
+            default:
+                break;
+        }
+    }
+
+    const Board board;
+    audio_tools::AudioStream &out;
+    float batteryVoltage = NAN;
+    BatteryAdc batteryAdc{board.battery, board.divider};
+    Metadata meta{};
+    AmpGate amp{board.amp};
+    AudioChain chain{};
+    BlockPool blocks{Output::BLOCK_BYTES, PCM_BLOCKS};
+    Output processed{out, chain, blocks};
+    Sink sink{processed};
+    Network network{};
+    Firmware firmware{};
+    PairingController pairing{[this](bool connectable, bool discoverable) {
+        log_i("Bluetooth %sconnectable, %sdiscoverable", connectable ? "" : "not ", discoverable ? "" : "not ");
+        sink.set_discoverability(discoverable ? ESP_BT_GENERAL_DISCOVERABLE : ESP_BT_NON_DISCOVERABLE);
+        sink.set_connectable(connectable);
+    }, PAIRING_WINDOW_MS};
+    PowerGovernor governor{};
+    HealthMonitor health{};
+    LinkMonitor linkMonitor{};
+    Settings settings{};
+    PeerList peers{};
+    dsp::Cue lowBatteryCue{LOW_BATTERY_CUE, 0.5f};
+    BatteryProtection protection{[this] { warnLowBattery(); }, [this] { beginShutdown(); }, [this] { shutdown(); }};
+    Button left{board.left, [this] { decreaseVolume(); }, [this] { previousTrack(); }};
+    Button right{board.right, [this] { increaseVolume(); }, [this] { nextTrack(); }};
+    Button center{board.center, [this] { changePlayState(); }, [this] { enterPairingMode(); }};
+    int loopHealth = -1;
+    int audioHealth = -1;
+
+private:
+    bool measureBattery() {
+        constexpr auto N = 10000;
+        batterySum += batteryAdc.read();
+        if (++batterySamples < N) return false;
+        batteryVoltage = static_cast<float>(batterySum) / N / 1000.0f;
+        batterySum = 0;
+        batterySamples = 0;
+        return true;
+    }
+
+    void applyPowerPolicy() {
+        const auto &policy = governor.policy();
+        log_i("Battery at %.0f %%, power level %u: gain %.2f, ceiling %.2f, optional DSP %s, CPU %lu MHz",
+              governor.getCharge() * 100.0f, governor.getLevel(), policy.maxGain, policy.limiterCeiling,
+              policy.optionalDsp ? "on" : "off", policy.cpuMhz);
+        chain.get<dsp::Gain>().setGain(policy.maxGain);
+        chain.get<dsp::Limiter>().setCeiling(policy.limiterCeiling);
+        chain.get<dsp::Equalizer>().setEnabled(policy.optionalDsp);
+        setCpuFrequencyMhz(policy.cpuMhz);
+    }
+
+    void applyLinkDepth() {
+        const auto &depth = linkMonitor.depth();
+        log_i("Link RSSI delta %.1f dB with %lu late blocks, jitter buffer depth %u: prefetch %u %%",
+              linkMonitor.getMetrics().rssi, linkMonitor.getMetrics().lateWindow, linkMonitor.getLevel(),
+              depth.prefetchPercent);
+        sink.set_i2s_ringbuffer_prefetch_percent(depth.prefetchPercent);
+    }
+
+    void warnLowBattery() {
+        log_w("Battery low: %.3f V", batteryVoltage);
+        processed.play(lowBatteryCue);
+    }
+
+    void beginShutdown() {
+        log_w("Battery empty: %.3f V, shutting down", batteryVoltage);
+        chain.get<dsp::Fade>().fadeTo(0.0f, SHUTDOWN_FADE_MS);
+        processed.play(lowBatteryCue);
+    }
+
+    void shutdown() {
+        settings.volume = static_cast<uint8_t>(sink.get_volume());
+        settings.save();
+        // Stops the sink and its I2S task before the driver goes away, the task may be blocked writing to it
+        sink.end();
+        digitalWrite(board.amp, LOW);
+        out.end();
+        log_w("Entering deep sleep without wakeup sources");
+        Serial.flush();
+        esp_sleep_disable_wakeup_source(ESP_SLEEP_WAKEUP_ALL);
+        esp_deep_sleep_start();
+    }
+
+    void increaseVolume() {
+        log_i("Increase volume");
+        setVolume(sink.get_volume() + 4);
+    }
+
+    void nextTrack() {
+        log_i("Next track");
+        sink.next();
+    }
+
+    void decreaseVolume() {
+        log_i("Decrease volume");
+        setVolume(sink.get_volume() - 4);
+    }
+
+    void previousTrack() {
+        log_i("Previous track");
+        sink.previous();
+    }
+
+    void changePlayState() {
+        log_i("Change play state");
+        switch (meta.playing) {
+            case ESP_AVRC_PLAYBACK_PAUSED:
+            case ESP_AVRC_PLAYBACK_STOPPED:
+                sink.play();
+                break;
+            case ESP_AVRC_PLAYBACK_PLAYING:
+                sink.pause();
+                break;
+            default:
+                break;
+        }
+    }
+
+    void enterPairingMode() {
+        log_i("Enter pairing mode for %lu s", PAIRING_WINDOW_MS / 1000);
+        pairing.startPairing(Clock::millis());
+        if (sink.is_connected()) sink.disconnect();
+    }
+
+    void switchPeer() {
+        const auto current = sink.get_current_peer_address();
+        const auto target = peers.next(current && sink.is_connected() ? *current : nullptr);
+        if (!target) {
+            log_i("No other paired device to switch to");
+            return;
+        }
+        log_i("Switch to " ESP_BD_ADDR_STR, ESP_BD_ADDR_HEX(target));
+        memcpy(switchTarget, target, sizeof(switchTarget));
+        switchStart = Clock::millis();
+        // A page to the known address skips the inquiry, the sink only holds one connection at a time
+        if (sink.is_connected()) {
+            switchPending = true;
+            sink.disconnect();
+        } else {
+            sink.connect_to(switchTarget);
+        }
+    }
+
+    void logStatus(uint32_t now) {
+        log_i("Metadata:"
+              "\nBattery voltage: %.3f V"
+              "\nPlaying: %s"
+              "\nTitle: %s"
+              "\nArtist: %s"
+              "\nAlbum: %s"
+              "\nPlaytime: %lu"
+              "\nPosition: %lu"
+              "\nVolume: %d",
+              batteryVoltage,
+              meta.playing == ESP_AVRC_PLAYBACK_PLAYING ? "true" : "false",
+              meta.title, meta.artist, meta.album,
+              meta.playtime, meta.position, meta.volume);
+        const auto &dsp = processed.getMetrics();
+        log_i("DSP: %.1f ns/sample (max %.1f)", dsp.nsPerSample, dsp.maxNsPerSample);
+        log_i("Audio callback: worst gap between blocks %lu us", dsp.maxGapMicros);
+        const auto &link = linkMonitor.getMetrics();
+        log_i("Link: RSSI delta %.1f dB (last %d), %lu late blocks (%lu in last window), jitter buffer %u %%",
+              link.rssi, link.lastRssi, link.late, link.lateWindow, linkMonitor.depth().prefetchPercent);
+        log_i("Audio memory traffic: %.1f kB/s", static_cast<float>(dsp.trafficBytes - traffic) / 2048.0f);
+        traffic = dsp.trafficBytes;
+        log_i("Amplifier %s, shut down for %lu s since boot", amp.isEnabled() ? "on" : "off",
+              amp.gatedMillis(now) / 1000);
+        const auto pool = blocks.stats();
+        log_i("Blocks: %u of %u free (minimum %u), %lu exhausted, %lu dropped", pool.available, PCM_BLOCKS,
+              pool.minAvailable, pool.exhausted, dsp.dropped);
+        health.report();
+        if (dsp.overBudget) {
+            log_w("DSP exceeded %.0f ns/sample in %u blocks", DSP_BUDGET_NS, dsp.overBudget);
+        }
+    }
+
+    uint32_t batterySum = 0;
+    uint32_t batterySamples = 0;
+    uint32_t lastStatus = 0;
+    uint64_t traffic = 0;
+    esp_bd_addr_t switchTarget{};
+    volatile bool switchPending = false;
+    volatile uint32_t switchStart = 0;
+};
+
+
+#endif //APP_HPP
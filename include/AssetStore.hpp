@@ -0,0 +1,182 @@
+#ifndef ASSET_STORE_HPP
+#define ASSET_STORE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#ifdef ESP_PLATFORM
+#include <Arduino.h>
+#include <esp_partition.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+
+/*
+ * Read-only store for cues, fonts and tables packed by scripts/pack_assets.py. The blob starts with a Header
+ * and an index of Entry sorted by name, followed by the assets aligned to ALIGNMENT bytes. On the device it
+ * lives in the "assets" data partition and is memory mapped, on the host the packed file is mapped instead;
+ * either way find() returns pointers into the mapping, nothing is copied to RAM.
+ */
+class AssetStore {
+public:
+    static constexpr uint32_t MAGIC = 0x414B5053;  /* "SPKA" little endian */
+    static constexpr uint16_t VERSION = 1;
+    static constexpr size_t ALIGNMENT = 16;
+    static constexpr size_t MAX_NAME = 24;         /* Including the terminator */
+#ifdef ESP_PLATFORM
+    static constexpr esp_partition_subtype_t SUBTYPE = static_cast<esp_partition_subtype_t>(0x40);
+#endif
+
+    struct Header {
+        uint32_t magic;
+        uint16_t version;
+        uint16_t count;  /* Index entries */
+        uint32_t size;   /* Blob bytes including the header */
+        uint32_t reserved;
+    };
+
+    struct Entry {
+        char name[MAX_NAME];
+        uint32_t offset;  /* From the start of the blob */
+        uint32_t size;
+    };
+
+    struct Asset {
+        const uint8_t *data;
+        size_t size;
+
+        explicit operator bool() const { return data != nullptr; }
+
+        // Views the asset as an array of T, the packer aligns every asset to ALIGNMENT
+        template<typename T>
+        const T *as() const { return reinterpret_cast<const T *>(data); }
+
+        template<typename T>
+        size_t count() const { return size / sizeof(T); }
+    };
+
+    AssetStore() = default;
+    AssetStore(const AssetStore &) = delete;
+    AssetStore &operator=(const AssetStore &) = delete;
+    ~AssetStore() { end(); }
+
+#ifdef ESP_PLATFORM
+    // Maps the assets partition into the data address space
+    bool begin(const char *label = "assets") {
+        end();
+        const auto partition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, SUBTYPE, label);
+        if (!partition) {
+            log_w("No %s partition", label);
+            return false;
+        }
+        const void *mapped = nullptr;
+        if (esp_partition_mmap(partition, 0, partition->size, ESP_PARTITION_MMAP_DATA, &mapped, &handle) != ESP_OK) {
+            log_e("Mapping the %s partition failed", label);
+            return false;
+        }
+        if (!attach(mapped, partition->size)) {
+            log_w("The %s partition holds no valid assets", label);
+            end();
+            return false;
+        }
+        log_i("%u assets, %u bytes", header->count, header->size);
+        return true;
+    }
+
+    void end() {
+        if (handle) spi_flash_munmap(handle);
+        handle = 0;
+        detach();
+    }
+#else
+    // Maps a packed file, used by host builds
+    bool begin(const char *path) {
+        end();
+        const auto fd = open(path, O_RDONLY);
+        if (fd < 0) return false;
+        struct stat info{};
+        void *mapped = MAP_FAILED;
+        if (fstat(fd, &info) == 0 && info.st_size > 0) {
+            mapped = mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+        }
+        close(fd);
+        if (mapped == MAP_FAILED) return false;
+        mappedBytes = static_cast<size_t>(info.st_size);
+        if (!attach(mapped, mappedBytes)) {
+            munmap(mapped, mappedBytes);
+            mappedBytes = 0;
+            return false;
+        }
+        return true;
+    }
+
+    void end() {
+        if (mappedBytes) munmap(const_cast<uint8_t *>(base), mappedBytes);
+        mappedBytes = 0;
+        detach();
+    }
+#endif
+
+    // Looks up an asset by name, returns an empty asset if there is none
+    Asset find(const char *name) const {
+        size_t low = 0;
+        auto high = count();
+        while (low < high) {
+            const auto middle = (low + high) / 2;
+            const auto order = strncmp(name, index[middle].name, MAX_NAME);
+            if (order == 0) return {base + index[middle].offset, index[middle].size};
+            if (order < 0) high = middle;
+            else low = middle + 1;
+        }
+        return {nullptr, 0};
+    }
+
+    size_t count() const { return header ? header->count : 0; }
+
+    const Entry &operator[](size_t i) const { return index[i]; }
+
+private:
+    // Checks the blob before any pointer into it is handed out
+    bool attach(const void *mapped, size_t capacity) {
+        const auto bytes = static_cast<const uint8_t *>(mapped);
+        const auto candidate = reinterpret_cast<const Header *>(bytes);
+        if (capacity < sizeof(Header) || candidate->magic != MAGIC || candidate->version != VERSION) return false;
+        if (candidate->size > capacity || sizeof(Header) + candidate->count * sizeof(Entry) > candidate->size) {
+            return false;
+        }
+        const auto entries = reinterpret_cast<const Entry *>(bytes + sizeof(Header));
+        for (size_t i = 0; i < candidate->count; ++i) {
+            const auto &entry = entries[i];
+            if (entry.name[MAX_NAME - 1] != '\0' || entry.offset % ALIGNMENT != 0) return false;
+            if (entry.offset > candidate->size || entry.size > candidate->size - entry.offset) return false;
+            if (i > 0 && strncmp(entries[i - 1].name, entry.name, MAX_NAME) >= 0) return false;
+        }
+        base = bytes;
+        header = candidate;
+        index = entries;
+        return true;
+    }
+
+    void detach() {
+        base = nullptr;
+        header = nullptr;
+        index = nullptr;
+    }
+
+    const uint8_t *base = nullptr;
+    const Header *header = nullptr;
+    const Entry *index = nullptr;
+#ifdef ESP_PLATFORM
+    spi_flash_mmap_handle_t handle = 0;
+#else
+    size_t mappedBytes = 0;
+#endif
+};
+
+
+#endif //ASSET_STORE_HPP
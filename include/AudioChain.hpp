@@ -0,0 +1,37 @@
+#ifndef AUDIO_CHAIN_HPP
+#define AUDIO_CHAIN_HPP
+
+#include "Pipeline.hpp"
+
+#ifndef AUDIO_OUTPUT_BITS
+#define AUDIO_OUTPUT_BITS 32
+#endif
+
+
+/*
+ * The processing chain the firmware applies to every block between the A2DP sink and the I2S output.
+ * Anything replaying captured audio through the speaker's path must use this exact type and configuration
+ * so its output is bit-identical to the device.
+ *
+ * Processing, including the source volume, runs in Q31 with Headroom::BITS of headroom for equalizer
+ * boosts, which the limiter removes again. The I2S output uses 32-bit slots unless AUDIO_OUTPUT_BITS is 16,
+ * in which case the output is dithered down to 16 bits.
+ */
+using AudioChain = dsp::Pipeline<int32_t, dsp::Headroom, dsp::MonoDownmix, dsp::Equalizer, dsp::Volume, dsp::Gain,
+                                 dsp::Fade, dsp::Limiter>;
+using OutputSample = std::conditional_t<AUDIO_OUTPUT_BITS == 16, int16_t, int32_t>;
+
+inline void configureChain(AudioChain &chain, float sampleRate = 44100.0f) {
+    chain.setSampleRate(sampleRate);
+    chain.get<dsp::MonoDownmix>().setEnabled(true);
+    chain.get<dsp::Volume>().setVolume(0x7F);
+    chain.get<dsp::Gain>().setGain(1.0f);
+    chain.get<dsp::Fade>().fadeTo(1.0f, 0.0f);
+    chain.get<dsp::Limiter>().setCeiling(1.0f);
+    chain.get<dsp::Limiter>().setRelease(50.0f);
+    chain.get<dsp::Limiter>().setHeadroom(chain.get<dsp::Headroom>().getBits());
+    chain.reset();
+}
+
+
+#endif //AUDIO_CHAIN_HPP
@@ -0,0 +1,59 @@
+#ifndef AVRC_PAYLOAD_HPP
+#define AVRC_PAYLOAD_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+
+/*
+ * Length-aware parsing of AVRC payloads. Nothing here trusts the remote for NUL termination or format:
+ * every function reads at most the given number of bytes and never allocates. Only the C library is used,
+ * so the host tests and the fuzz target in test/fuzz drive these directly.
+ */
+namespace avrc {
+
+// Length of the payload up to the first NUL, but never more than length
+inline size_t payloadLength(const uint8_t *data, size_t length) {
+    if (data == nullptr) return 0;
+    const auto end = static_cast<const uint8_t *>(memchr(data, '\0', length));
+    return end ? static_cast<size_t>(end - data) : length;
+}
+
+/*
+ * Copies the payload into dst as a NUL-terminated string, truncating on a UTF-8 character boundary if it
+ * does not fit and replacing control characters with spaces. Returns the number of bytes copied.
+ */
+inline size_t copyText(char *dst, size_t capacity, const uint8_t *data, size_t length) {
+    if (capacity == 0) return 0;
+    auto n = payloadLength(data, length);
+    if (n >= capacity) {
+        n = capacity - 1;
+        while (n > 0 && (data[n] & 0xC0) == 0x80) n--;
+    }
+    for (size_t i = 0; i < n; ++i) {
+        dst[i] = data[i] < 0x20 ? ' ' : static_cast<char>(data[i]);
+    }
+    dst[n] = '\0';
+    return n;
+}
+
+// Parses an unsigned decimal number, rejecting empty payloads, non-digits and values not fitting in 32 bits
+inline bool parseUnsigned(const uint8_t *data, size_t length, uint32_t &value) {
+    const auto n = payloadLength(data, length);
+    if (n == 0) return false;
+    uint32_t result = 0;
+    for (size_t i = 0; i < n; ++i) {
+        const auto digit = static_cast<uint32_t>(data[i] - '0');
+        if (digit > 9) return false;
+        if (result > (UINT32_MAX - digit) / 10) return false;
+        result = result * 10 + digit;
+    }
+    value = result;
+    return true;
+}
+
+}
+
+
+#endif //AVRC_PAYLOAD_HPP
@@ -0,0 +1,92 @@
+#ifndef BATTERY_ADC_HPP
+#define BATTERY_ADC_HPP
+
+#include <Arduino.h>
+#include <Preferences.h>
+#include <esp_adc_cal.h>
+#include "Memory.hpp"
+
+
+/*
+ * Battery voltage measurement through a resistor divider on an ADC1 pin. The ADC is characterized from
+ * the eFuse two-point or Vref data where available and the per-unit divider ratio can be calibrated against
+ * a reference voltage and is stored in NVS. Both are folded into a lookup table from raw ADC reading to
+ * battery millivolts, so a conversion is a single table access.
+ */
+class BatteryAdc {
+    static constexpr const char *NAMESPACE = "adc";
+    static constexpr uint32_t DEFAULT_VREF = 1100;
+    static constexpr size_t STEPS = 1 << 12;
+public:
+    BatteryAdc(uint8_t pin, float divider) : pin(pin), nominal(divider), divider(divider) {}
+
+    void begin() {
+        // Read on every conversion, PSRAM would put a cache miss on the loop's hottest path
+        if (!table) table = mem::allocate<uint16_t>(STEPS, mem::Placement::INTERNAL, "battery table");
+        analogReadResolution(12);
+        analogSetPinAttenuation(pin, ADC_0db);
+        source = esp_adc_cal_characterize(ADC_UNIT_1, ADC_ATTEN_DB_0, ADC_WIDTH_BIT_12, DEFAULT_VREF, &adc);
+        Preferences prefs;
+        if (prefs.begin(NAMESPACE, true)) {
+            divider = prefs.getFloat("divider", nominal);
+            prefs.end();
+        }
+        build();
+        log_i("Battery ADC characterized from %s, divider %.4f%s", sourceName(), divider,
+              divider == nominal ? " (nominal)" : " (calibrated)");
+    }
+
+    // Battery voltage in millivolts
+    uint16_t read() const { return table ? table[analogRead(pin) & (STEPS - 1)] : 0; }
+
+    /*
+     * Calibrates the divider ratio against the actual battery voltage measured externally, averaging samples
+     * readings, and stores it in NVS
+     */
+    void calibrate(uint32_t actualMilliVolts, uint32_t samples = 1000) {
+        uint64_t sum = 0;
+        for (uint32_t i = 0; i < samples; ++i) {
+            sum += esp_adc_cal_raw_to_voltage(analogRead(pin), &adc);
+        }
+        divider = static_cast<float>(sum) / static_cast<float>(samples) / static_cast<float>(actualMilliVolts);
+        Preferences prefs;
+        if (prefs.begin(NAMESPACE, false)) {
+            prefs.putFloat("divider", divider);
+            prefs.end();
+        }
+        build();
+        log_i("Battery ADC divider calibrated to %.4f at %lu mV", divider, actualMilliVolts);
+    }
+
+    float getDivider() const { return divider; }
+
+    const char *sourceName() const {
+        switch (source) {
+            case ESP_ADC_CAL_VAL_EFUSE_TP:
+                return "eFuse two-point";
+            case ESP_ADC_CAL_VAL_EFUSE_VREF:
+                return "eFuse Vref";
+            default:
+                return "default Vref";
+        }
+    }
+
+private:
+    void build() {
+        if (!table) return;
+        for (size_t raw = 0; raw < STEPS; ++raw) {
+            const auto milliVolts = static_cast<float>(esp_adc_cal_raw_to_voltage(raw, &adc)) / divider;
+            table[raw] = static_cast<uint16_t>(std::min(milliVolts, static_cast<float>(UINT16_MAX)));
+        }
+    }
+
+    uint8_t pin;
+    float nominal;
+    float divider;
+    esp_adc_cal_value_t source = ESP_ADC_CAL_VAL_DEFAULT_VREF;
+    esp_adc_cal_characteristics_t adc{};
+    uint16_t *table = nullptr;
+};
+
+
+#endif //BATTERY_ADC_HPP
@@ -0,0 +1,71 @@
+#ifndef BATTERY_PROTECTION_HPP
+#define BATTERY_PROTECTION_HPP
+
+#include <cmath>
+#include <functional>
+
+
+/*
+ * Protects the cell from over-discharge. Below the warning threshold the warning callback runs once and is
+ * only re-armed after the voltage recovered above the recovery threshold. Once CONFIRMATIONS consecutive
+ * measurements are at or below the cutoff the cutoff callback runs (fade out, warning cue) and after the
+ * shutdown delay the shutdown callback (save state, deep sleep). Requiring consecutive measurements keeps
+ * bass transients sagging the voltage from triggering a shutdown.
+ */
+class BatteryProtection {
+    static constexpr uint8_t CONFIRMATIONS = 3;
+public:
+    using Callback = std::function<void()>;
+
+    enum class State : uint8_t { NORMAL, WARNING, CUTOFF };
+
+    struct Thresholds {
+        float warning = 3.45f;
+        float recover = 3.55f;
+        float cutoff = 3.30f;
+    };
+
+    BatteryProtection(Callback warning, Callback cutoff, Callback shutdown, uint32_t shutdownDelay = 2000)
+            : warning(std::move(warning)), cutoff(std::move(cutoff)), shutdown(std::move(shutdown)),
+              shutdownDelay(shutdownDelay) {}
+
+    void setThresholds(const Thresholds &value) { thresholds = value; }
+
+    // Feeds a new battery voltage measurement
+    void update(float voltage, uint32_t now) {
+        if (std::isnan(voltage) || state == State::CUTOFF) return;
+        belowCutoff = voltage <= thresholds.cutoff ? belowCutoff + 1 : 0;
+        if (belowCutoff >= CONFIRMATIONS) {
+            state = State::CUTOFF;
+            cutoffTime = now;
+            if (cutoff) cutoff();
+        } else if (state == State::NORMAL && voltage <= thresholds.warning) {
+            state = State::WARNING;
+            if (warning) warning();
+        } else if (state == State::WARNING && voltage >= thresholds.recover) {
+            state = State::NORMAL;
+        }
+    }
+
+    void loop(uint32_t now) {
+        if (state != State::CUTOFF || shutdownDone || now - cutoffTime < shutdownDelay) return;
+        shutdownDone = true;
+        if (shutdown) shutdown();
+    }
+
+    State getState() const { return state; }
+
+private:
+    Callback warning;
+    Callback cutoff;
+    Callback shutdown;
+    uint32_t shutdownDelay;
+    Thresholds thresholds{};
+    State state = State::NORMAL;
+    uint8_t belowCutoff = 0;
+    uint32_t cutoffTime = 0;
+    bool shutdownDone = false;
+};
+
+
+#endif //BATTERY_PROTECTION_HPP
@@ -0,0 +1,112 @@
+#ifndef BENCHMARK_HPP
+#define BENCHMARK_HPP
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+
+#ifdef ESP_PLATFORM
+#include <Arduino.h>
+#else
+#include <chrono>
+#endif
+
+
+/*
+ * Timing harness for microbenchmarks. Every benchmark runs REPEATS times after a warm-up run and prints one
+ * JSON line with the minimum and median cost per item; the minimum is the figure to compare, the median
+ * shows how much interrupts and the other core disturbed the run. On the device the cost is counted in CPU
+ * cycles, host builds time the same kernels in nanoseconds. Every result is also recorded by name, so
+ * tests can check which kernels ran.
+ */
+namespace bench {
+
+constexpr size_t REPEATS = 15;
+constexpr size_t MAX_RECORDS = 32;
+
+struct Result {
+    float min;     /* Cycles per item on the device, ns per item on the host */
+    float median;
+};
+
+struct Record {
+    const char *name;
+    Result result;
+};
+
+namespace detail {
+inline Record records[MAX_RECORDS]{};
+inline size_t recorded = 0;
+}
+
+#ifdef ESP_PLATFORM
+inline uint32_t now() { return ESP.getCycleCount(); }
+#else
+inline uint32_t now() {
+    using namespace std::chrono;
+    return static_cast<uint32_t>(duration_cast<nanoseconds>(steady_clock::now().time_since_epoch()).count());
+}
+#endif
+
+// Times fn processing items units of work, prepare runs untimed before every repetition
+template<typename Prepare, typename Fn>
+Result run(const char *name, uint32_t items, Prepare &&prepare, Fn &&fn) {
+    uint32_t ticks[REPEATS];
+    prepare();
+    fn();
+    for (auto &value: ticks) {
+        prepare();
+        const auto start = now();
+        fn();
+        value = now() - start;
+    }
+    std::sort(ticks, ticks + REPEATS);
+    const auto perItem = [items](uint32_t value) { return static_cast<float>(value) / static_cast<float>(items); };
+    const Result result{perItem(ticks[0]), perItem(ticks[REPEATS / 2])};
+    if (detail::recorded < MAX_RECORDS) detail::records[detail::recorded++] = {name, result};
+#ifdef ESP_PLATFORM
+    const auto mhz = getCpuFrequencyMhz();
+    Serial.printf("{\"name\":\"%s\",\"items\":%lu,\"cycles_min\":%.2f,\"cycles_median\":%.2f,"
+                  "\"ns_min\":%.2f,\"cpu_mhz\":%lu}\n", name, items, result.min, result.median,
+                  result.min * 1000.0f / static_cast<float>(mhz), mhz);
+#else
+    printf("{\"name\":\"%s\",\"items\":%u,\"ns_min\":%.2f,\"ns_median\":%.2f}\n", name, items, result.min,
+           result.median);
+#endif
+    return result;
+}
+
+template<typename Fn>
+Result run(const char *name, uint32_t items, Fn &&fn) {
+    return run(name, items, [] {}, std::forward<Fn>(fn));
+}
+
+// Number of results recorded since the start or the last clear()
+inline size_t count() { return detail::recorded; }
+
+inline const Record &record(size_t i) { return detail::records[i]; }
+
+// The latest result recorded under the name, nullptr if there is none
+inline const Record *find(const char *name) {
+    for (auto i = detail::recorded; i > 0; --i) {
+        if (strcmp(detail::records[i - 1].name, name) == 0) return &detail::records[i - 1];
+    }
+    return nullptr;
+}
+
+inline void clear() { detail::recorded = 0; }
+
+// Marks the end of the results for the collecting script
+inline void done() {
+#ifdef ESP_PLATFORM
+    Serial.println("{\"done\":true}");
+#else
+    printf("{\"done\":true}\n");
+#endif
+}
+
+}
+
+
+#endif //BENCHMARK_HPP
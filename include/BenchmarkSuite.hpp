@@ -0,0 +1,149 @@
+#ifndef BENCHMARK_SUITE_HPP
+#define BENCHMARK_SUITE_HPP
+
+#include <cmath>
+#include <cstring>
+#include <esp32/rom/crc.h>
+#include "AudioChain.hpp"
+#include "BatteryAdc.hpp"
+#include "Benchmark.hpp"
+#include "Button.hpp"
+#include "Metadata.hpp"
+#include "Oscillator.hpp"
+#include "PowerGovernor.hpp"
+
+
+/*
+ * The DSP and control kernels of the speaker, shared by the benchmark firmware and the host benchmarks in
+ * test/test_benchmark so both time the same list. The results are recorded by bench::run().
+ */
+namespace bench {
+
+constexpr size_t FRAMES = 256;  /* Frames per block, as in the audio path */
+
+struct Pins {
+    uint8_t battery;
+    float divider;
+    uint8_t buttons[3];
+};
+
+namespace detail {
+
+inline int16_t input[FRAMES * 2];
+inline int32_t block[FRAMES * 2];
+inline int16_t narrow[FRAMES * 2];
+inline int32_t descriptor[FRAMES * 2];  /* Stands in for the I2S driver's DMA descriptor */
+constexpr dsp::Tone CUE[] = {{880, 1000}};
+
+inline void fill() {
+    dsp::convert(input, block, FRAMES * 2);
+}
+
+template<typename Chain>
+void stage(const char *name, Chain &chain) {
+    chain.setSampleRate(44100.0f);
+    run(name, FRAMES, fill, [&chain] { chain.process(block, FRAMES); });
+}
+
+inline void configureBands(dsp::Equalizer<int32_t> &eq) {
+    for (size_t i = 0; i < dsp::Equalizer<int32_t>::MAX_BANDS; ++i) {
+        eq.setBand(i, {dsp::Filter::PEAKING, 60.0f * static_cast<float>(1 << (2 * i)), 1.0f, 3.0f});
+    }
+}
+
+}
+
+inline void dspKernels() {
+    using namespace detail;
+    for (size_t i = 0; i < FRAMES * 2; ++i) {
+        input[i] = static_cast<int16_t>(30000.0f * std::sin(static_cast<float>(i) * 0.05f));
+    }
+
+    run("convert_q15_q31", FRAMES * 2, [] { dsp::convert(input, block, FRAMES * 2); });
+
+    static dsp::Pipeline<int32_t, dsp::MonoDownmix> downmix{};
+    downmix.get<dsp::MonoDownmix>().setEnabled(true);
+    stage("downmix", downmix);
+
+    static dsp::Pipeline<int32_t, dsp::Gain> gain{};
+    gain.get<dsp::Gain>().setGain(0.5f);
+    stage("gain", gain);
+
+    static dsp::Pipeline<int32_t, dsp::Volume> volume{};
+    volume.get<dsp::Volume>().setVolume(64);
+    stage("volume", volume);
+
+    static dsp::Pipeline<int32_t, dsp::Equalizer> eq{};
+    eq.setSampleRate(44100.0f);
+    configureBands(eq.get<dsp::Equalizer>());
+    stage("equalizer_5_bands", eq);
+
+    static dsp::Pipeline<int32_t, dsp::Limiter> limiter{};
+    limiter.get<dsp::Limiter>().setCeiling(0.25f);
+    stage("limiter", limiter);
+
+    static AudioChain chain{};
+    configureChain(chain);
+    configureBands(chain.get<dsp::Equalizer>());
+    stage("chain_fused", chain);
+    run("chain_staged", FRAMES, fill, [] { chain.processChained(block, FRAMES); });
+    run("convert_then_chain", FRAMES, [] {
+        dsp::convert(input, block, FRAMES * 2);
+        chain.process(block, FRAMES);
+    });
+    run("chain_widening", FRAMES, [] { chain.process(input, block, FRAMES); });
+
+    // The copy i2s_write makes into the driver's descriptors, per byte, so 1000 / ns_min is MB/s
+    run("block_copy_bytes", sizeof(block), [] { memcpy(descriptor, block, sizeof(block)); });
+    // A 32-bit block from the sink to the driver before and after widening moved into the chain pass
+    static volatile uint32_t crc = 0;
+    run("path_separate_convert", FRAMES, [] {
+        dsp::convert(input, block, FRAMES * 2);
+        chain.process(block, FRAMES);
+        crc = crc32_le(crc, reinterpret_cast<const uint8_t *>(block), sizeof(block));
+        memcpy(descriptor, block, sizeof(block));
+    });
+    run("path_widening", FRAMES, [] {
+        chain.process(input, block, FRAMES);
+        memcpy(descriptor, block, sizeof(block));
+    });
+
+    static dsp::Dither dither{};
+    run("dither_q31_q15", FRAMES, fill, [] { dither.process(block, narrow, FRAMES); });
+
+    static dsp::Cue cue{CUE, 0.5f};
+    run("cue_mix", FRAMES, [] { cue.start(44100.0f); }, [] { cue.mix(block, FRAMES); });
+}
+
+inline void controlKernels(const Pins &pins) {
+    static Metadata meta{};
+    static const uint8_t title[] = "Ein Stück mit einem ziemlich langen Titel, der gekürzt werden muss";
+    static const uint8_t playtime[] = "245000";
+    run("metadata_title", 1, [] { meta.onAttribute(ESP_AVRC_MD_ATTR_TITLE, title, sizeof(title)); });
+    run("metadata_playtime", 1, [] { meta.onAttribute(ESP_AVRC_MD_ATTR_PLAYING_TIME, playtime, sizeof(playtime)); });
+
+    static BatteryAdc adc{pins.battery, pins.divider};
+    pinMode(pins.battery, INPUT);
+    adc.begin();
+    static volatile uint32_t sum = 0;
+    run("battery_read", 100, [] {
+        for (int i = 0; i < 100; ++i) sum += adc.read();
+    });
+    static PowerGovernor governor{};
+    static float voltage = 3.3f;
+    run("governor_update", 100, [] {
+        for (int i = 0; i < 100; ++i) governor.update(voltage = voltage > 4.2f ? 3.3f : voltage + 0.009f);
+    });
+
+    static Button buttons[] = {Button{pins.buttons[0], nullptr, nullptr}, Button{pins.buttons[1], nullptr, nullptr},
+                               Button{pins.buttons[2], nullptr, nullptr}};
+    for (auto &button: buttons) button.setup();
+    run("button_poll", 3, [] {
+        for (auto &button: buttons) button.loop();
+    });
+}
+
+}
+
+
+#endif //BENCHMARK_SUITE_HPP
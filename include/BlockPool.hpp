@@ -0,0 +1,154 @@
+#ifndef BLOCK_POOL_HPP
+#define BLOCK_POOL_HPP
+
+#include <atomic>
+#include <new>
+#include "Memory.hpp"
+
+
+/*
+ * Lock-free pool of fixed-size PCM blocks, preallocated at boot and aligned to cache lines. Blocks are
+ * handed out as reference counted Refs, so one block can be shared with analysis taps without copying and
+ * returns to the pool once the last reference is gone. The free list is a Treiber stack whose head carries
+ * a tag against ABA, packed into 32 bits so it stays lock-free on the ESP32.
+ */
+class BlockPool {
+    static constexpr uint16_t NONE = 0xFFFF;
+    static constexpr size_t CACHE_LINE = 32;
+public:
+    struct Stats {
+        uint32_t acquired;
+        uint32_t exhausted;
+        uint16_t available;
+        uint16_t minAvailable;
+    };
+
+    class Ref {
+    public:
+        Ref() = default;
+
+        Ref(const Ref &other) : pool(other.pool), index(other.index) {
+            if (pool) pool->retain(index);
+        }
+
+        Ref(Ref &&other) noexcept { swap(other); }
+
+        Ref &operator=(Ref other) noexcept {
+            swap(other);
+            return *this;
+        }
+
+        ~Ref() {
+            if (pool) pool->release(index);
+        }
+
+        explicit operator bool() const { return pool != nullptr; }
+
+        template<typename T>
+        T *as() const { return reinterpret_cast<T *>(pool->data(index)); }
+
+        // Bytes of valid data in the block
+        size_t size() const { return pool->headers[index].size; }
+
+        void setSize(size_t bytes) { pool->headers[index].size = static_cast<uint32_t>(bytes); }
+
+        void reset() { Ref().swap(*this); }
+
+    private:
+        friend class BlockPool;
+
+        Ref(BlockPool *pool, uint16_t index) : pool(pool), index(index) {}
+
+        void swap(Ref &other) noexcept {
+            std::swap(pool, other.pool);
+            std::swap(index, other.index);
+        }
+
+        BlockPool *pool = nullptr;
+        uint16_t index = NONE;
+    };
+
+    BlockPool(size_t blockBytes, uint16_t count)
+            : stride((blockBytes + CACHE_LINE - 1) / CACHE_LINE * CACHE_LINE), count(count) {}
+
+    // Allocates all blocks, must be called before the first acquire()
+    bool begin() {
+        if (storage) return true;
+        headers = mem::allocate<Header>(count, mem::Placement::INTERNAL, "pool headers");
+        storage = mem::allocate<uint8_t>(stride * count, mem::Placement::INTERNAL, "pcm blocks", CACHE_LINE);
+        if (!headers || !storage) return false;
+        for (uint16_t i = 0; i < count; ++i) {
+            new(&headers[i]) Header{};
+            headers[i].next.store(i + 1 < count ? i + 1 : NONE, std::memory_order_relaxed);
+        }
+        head.store(0, std::memory_order_release);
+        available.store(count, std::memory_order_relaxed);
+        minAvailable.store(count, std::memory_order_relaxed);
+        return true;
+    }
+
+    // Takes a block from the pool, the returned Ref is empty if the pool is exhausted
+    Ref acquire() {
+        auto old = head.load(std::memory_order_acquire);
+        uint16_t index;
+        do {
+            index = old & 0xFFFF;
+            if (index == NONE) {
+                exhausted.fetch_add(1, std::memory_order_relaxed);
+                return {};
+            }
+            const auto next = headers[index].next.load(std::memory_order_relaxed);
+            const auto tagged = ((old & 0xFFFF0000) + 0x10000) | next;
+            if (head.compare_exchange_weak(old, tagged, std::memory_order_acq_rel, std::memory_order_acquire)) break;
+        } while (true);
+        headers[index].refs.store(1, std::memory_order_relaxed);
+        headers[index].size = 0;
+        acquired.fetch_add(1, std::memory_order_relaxed);
+        const auto left = static_cast<uint16_t>(available.fetch_sub(1, std::memory_order_relaxed) - 1);
+        if (left < minAvailable.load(std::memory_order_relaxed)) {
+            minAvailable.store(left, std::memory_order_relaxed);
+        }
+        return {this, index};
+    }
+
+    Stats stats() const {
+        return {acquired.load(std::memory_order_relaxed), exhausted.load(std::memory_order_relaxed),
+                available.load(std::memory_order_relaxed), minAvailable.load(std::memory_order_relaxed)};
+    }
+
+    size_t blockBytes() const { return stride; }
+
+private:
+    struct Header {
+        std::atomic<uint16_t> refs{0};
+        std::atomic<uint16_t> next{NONE};
+        uint32_t size = 0;
+    };
+
+    uint8_t *data(uint16_t index) const { return storage + static_cast<size_t>(index) * stride; }
+
+    void retain(uint16_t index) { headers[index].refs.fetch_add(1, std::memory_order_relaxed); }
+
+    void release(uint16_t index) {
+        if (headers[index].refs.fetch_sub(1, std::memory_order_acq_rel) != 1) return;
+        auto old = head.load(std::memory_order_acquire);
+        do {
+            headers[index].next.store(old & 0xFFFF, std::memory_order_relaxed);
+        } while (!head.compare_exchange_weak(old, ((old & 0xFFFF0000) + 0x10000) | index,
+                                             std::memory_order_acq_rel, std::memory_order_acquire));
+        available.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    size_t stride;
+    uint16_t count;
+    Header *headers = nullptr;
+    uint8_t *storage = nullptr;
+    std::atomic<uint32_t> head{NONE};
+    std::atomic<uint32_t> acquired{0};
+    std::atomic<uint32_t> exhausted{0};
+    std::atomic<uint16_t> available{0};
+    std::atomic<uint16_t> minAvailable{0};
+};
+
+
+#endif //BLOCK_POOL_HPP
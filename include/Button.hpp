@@ -3,10 +3,12 @@
 
 #include <functional>
 #include <Bounce2.h>
+#include "Clock.hpp"
 
 
 class Button : public Bounce2::Button {
     static constexpr uint16_t LONG_PRESS_DURATION = 330;
+    static constexpr uint16_t DOUBLE_PRESS_INTERVAL = 300;
 public:
     using Callback = std::function<void()>;
 
@@ -21,22 +23,55 @@ public:
 
     void setup() { attach(pin, INPUT_PULLUP); }
 
+    // Two short presses within the interval run the callback, single short presses are then delayed by it
+    void setDoublePress(Callback value) { doublePress = std::move(value); }
+
+    // Runs exactly one action per press, durations are unsigned differences and therefore safe across a wrap
     void loop() {
-        static bool long_press = false;
         update();
-        if (isPressed() && !long_press && currentDuration() > LONG_PRESS_DURATION) {
-            long_press = true;
-            if (longPress) longPress();
+        if (isPressed() && !longPressed && currentDuration() >= LONG_PRESS_DURATION) {
+            longPressed = true;
+            runLongPress();
         }
         if (released()) {
-            long_press = false;
-            if (previousDuration() < LONG_PRESS_DURATION && shortPress) shortPress();
+            if (longPressed) {
+                longPressed = false;
+            } else if (previousDuration() >= LONG_PRESS_DURATION) {
+                // The loop was not polled while the button was held past the threshold
+                runLongPress();
+            } else if (!doublePress) {
+                if (shortPress) shortPress();
+            } else if (pendingShortPress) {
+                pendingShortPress = false;
+                doublePress();
+            } else {
+                pendingShortPress = true;
+                pendingSince = Clock::millis();
+            }
+        }
+        if (pendingShortPress && !isPressed() && Clock::millis() - pendingSince > DOUBLE_PRESS_INTERVAL) {
+            flushShortPress();
         }
     }
 
 private:
+    void runLongPress() {
+        flushShortPress();
+        if (longPress) longPress();
+    }
+
+    void flushShortPress() {
+        if (!pendingShortPress) return;
+        pendingShortPress = false;
+        if (shortPress) shortPress();
+    }
+
     Callback shortPress;
     Callback longPress;
+    Callback doublePress{};
+    bool longPressed = false;
+    bool pendingShortPress = false;
+    uint32_t pendingSince = 0;
 };
 
 
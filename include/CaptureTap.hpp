@@ -0,0 +1,147 @@
+#ifndef CAPTURE_TAP_HPP
+#define CAPTURE_TAP_HPP
+
+#include <Arduino.h>
+#include <atomic>
+#include <esp32/rom/crc.h>
+#include "BlockPool.hpp"
+
+
+/*
+ * Streams the PCM blocks passing one point of the audio path to the host for offline analysis. The audio
+ * path only hands a block reference to a single producer, single consumer ring, a low priority task frames
+ * and writes them to the port, so a slow port drops blocks instead of stalling the audio. Every frame is a
+ * Header, the PCM and a CRC32 over both; the sequence counts every offered block, so gaps in it mark the
+ * dropped ones. scripts/capture_wav.py turns the stream into WAV files.
+ *
+ * 32-bit stereo at 44.1 kHz needs about 360 kB/s, more than a 2 Mbaud port carries. With narrowing on, the
+ * capture task sends only the upper 16 bits of 32-bit samples, the same truncation dsp::convert applies,
+ * so the played point is captured without gaps at the cost of its lowest bits. The audio path is unchanged.
+ */
+class CaptureTap {
+public:
+    static constexpr uint32_t MAGIC = 0x434D4350;  /* "PCMC" little endian */
+    static constexpr size_t DEPTH = 4;
+    static constexpr size_t CHUNK = 64;  /* Samples narrowed at a time on the capture task's stack */
+
+    enum class Point : uint8_t {
+        OFF,
+        RECEIVED,  /* PCM as delivered by the sink */
+        PLAYED,    /* PCM as written to I2S */
+    };
+
+    struct __attribute__((packed)) Header {
+        uint32_t magic;
+        uint32_t sequence;
+        uint32_t dropped;     /* Blocks dropped since the capture started */
+        uint32_t sampleRate;
+        uint16_t bytes;       /* PCM bytes following the header */
+        uint8_t bits;         /* Bits per sample, always stereo */
+        Point point;
+    };
+
+    struct Stats {
+        uint32_t frames;
+        uint32_t dropped;
+        uint64_t bytes;
+    };
+
+    explicit CaptureTap(Print &port) : port(port) {}
+
+    bool begin(UBaseType_t priority = 1, BaseType_t core = tskNO_AFFINITY, uint32_t stack = 3072) {
+        return xTaskCreatePinnedToCore(run, "capture", stack, this, priority, &task, core) == pdPASS;
+    }
+
+    void setPoint(Point value) {
+        point.store(value, std::memory_order_relaxed);
+        sequence = 0;
+        dropped.store(0, std::memory_order_relaxed);
+    }
+
+    // Sends 32-bit blocks as 16-bit samples
+    void setNarrow(bool value) { narrow = value; }
+
+    bool wants(Point at) const { return task && point.load(std::memory_order_relaxed) == at; }
+
+    // Offers a block of the tapped point from the audio path, the block must not be modified afterwards
+    void push(Point at, const BlockPool::Ref &block, uint8_t bits, uint32_t sampleRate) {
+        if (!wants(at)) return;
+        const auto seq = sequence++;
+        const auto head = this->head.load(std::memory_order_relaxed);
+        if (!block || head - tail.load(std::memory_order_acquire) == DEPTH) {
+            dropped.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        auto &slot = slots[head % DEPTH];
+        slot.block = block;
+        slot.header = {MAGIC, seq, dropped.load(std::memory_order_relaxed), sampleRate,
+                       static_cast<uint16_t>(block.size()), bits, at};
+        this->head.store(head + 1, std::memory_order_release);
+        xTaskNotifyGive(task);
+    }
+
+    Stats stats() const { return {frames, dropped.load(std::memory_order_relaxed), bytes}; }
+
+private:
+    struct Slot {
+        BlockPool::Ref block{};
+        Header header{};
+    };
+
+    static void run(void *arg) {
+        const auto tap = static_cast<CaptureTap *>(arg);
+        for (;;) {
+            ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+            auto tail = tap->tail.load(std::memory_order_relaxed);
+            while (tail != tap->head.load(std::memory_order_acquire)) {
+                tap->send(tap->slots[tail % DEPTH]);
+                tap->tail.store(++tail, std::memory_order_release);
+            }
+        }
+    }
+
+    void send(Slot &slot) {
+        const auto data = slot.block.as<const uint8_t>();
+        const auto narrowing = narrow && slot.header.bits == 32;
+        const auto size = slot.header.bytes;
+        if (narrowing) {
+            slot.header.bits = 16;
+            slot.header.bytes = size / 2;
+        }
+        auto crc = crc32_le(0, reinterpret_cast<const uint8_t *>(&slot.header), sizeof(Header));
+        port.write(reinterpret_cast<const uint8_t *>(&slot.header), sizeof(Header));
+        if (narrowing) {
+            const auto samples = slot.block.as<const int32_t>();
+            int16_t chunk[CHUNK];
+            for (size_t i = 0; i < size / sizeof(int32_t); i += CHUNK) {
+                const auto n = std::min(CHUNK, size / sizeof(int32_t) - i);
+                for (size_t j = 0; j < n; ++j) chunk[j] = static_cast<int16_t>(samples[i + j] >> 16);
+                const auto narrowed = reinterpret_cast<const uint8_t *>(chunk);
+                crc = crc32_le(crc, narrowed, n * sizeof(int16_t));
+                port.write(narrowed, n * sizeof(int16_t));
+            }
+        } else {
+            crc = crc32_le(crc, data, size);
+            port.write(data, size);
+        }
+        port.write(reinterpret_cast<const uint8_t *>(&crc), sizeof(crc));
+        slot.block.reset();
+        frames++;
+        bytes += sizeof(Header) + slot.header.bytes + sizeof(crc);
+    }
+
+    Print &port;
+    TaskHandle_t task = nullptr;
+    std::atomic<Point> point{Point::OFF};
+    bool narrow = false;
+    Slot slots[DEPTH]{};
+    std::atomic<uint32_t> head{0};
+    std::atomic<uint32_t> tail{0};
+    uint32_t sequence = 0;
+    std::atomic<uint32_t> dropped{0};
+    uint32_t frames = 0;
+    uint64_t bytes = 0;
+};
+
+
+#endif //CAPTURE_TAP_HPP
@@ -0,0 +1,19 @@
+#ifndef CLOCK_HPP
+#define CLOCK_HPP
+
+#include <Arduino.h>
+
+
+/*
+ * Time source of the firmware's own timing logic, the Arduino clock. Host builds get it from the Arduino
+ * mock in test/stubs, where time is virtual and only moves when the test advances it, so timeouts, hold
+ * times and periodic work can be simulated faster than real time; see test/test_simulation.
+ */
+struct Clock {
+    static uint32_t millis() { return ::millis(); }
+
+    static uint32_t micros() { return ::micros(); }
+};
+
+
+#endif //CLOCK_HPP
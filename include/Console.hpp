@@ -0,0 +1,75 @@
+#ifndef CONSOLE_HPP
+#define CONSOLE_HPP
+
+#include <Arduino.h>
+#include <cstring>
+#include <functional>
+
+
+/*
+ * Line based command channel over a stream. Each line is split at whitespace and dispatched to the command
+ * registered under its first word, any other word like "help" lists the usage of all commands. Call loop()
+ * from the loop, it never blocks on the stream.
+ */
+class Console {
+    static constexpr size_t MAX_LINE = 160;
+    static constexpr size_t MAX_COMMANDS = 8;
+    static constexpr size_t MAX_ARGS = 8;
+public:
+    // Runs a command with its arguments, argv[0] being the command name, returns false on invalid arguments
+    using Handler = std::function<bool(int argc, char **argv)>;
+
+    explicit Console(Stream &stream) : stream(stream) {}
+
+    bool add(const char *name, const char *usage, Handler handler) {
+        if (count == MAX_COMMANDS) return false;
+        commands[count++] = {name, usage, std::move(handler)};
+        return true;
+    }
+
+    void loop() {
+        while (stream.available() > 0) {
+            const auto c = static_cast<char>(stream.read());
+            if (c == '\r' || c == '\n') {
+                line[length] = '\0';
+                if (length > 0) dispatch();
+                length = 0;
+            } else if (length + 1 < MAX_LINE) {
+                line[length++] = c;
+            }
+        }
+    }
+
+private:
+    struct Command {
+        const char *name;
+        const char *usage;
+        Handler handler;
+    };
+
+    void dispatch() {
+        char *argv[MAX_ARGS];
+        int argc = 0;
+        char *save = nullptr;
+        for (auto token = strtok_r(line, " \t", &save); token && argc < static_cast<int>(MAX_ARGS);
+             token = strtok_r(nullptr, " \t", &save)) {
+            argv[argc++] = token;
+        }
+        if (argc == 0) return;
+        for (size_t i = 0; i < count; ++i) {
+            if (strcmp(commands[i].name, argv[0]) != 0) continue;
+            if (!commands[i].handler(argc, argv)) stream.printf("Usage: %s\n", commands[i].usage);
+            return;
+        }
+        for (size_t i = 0; i < count; ++i) stream.printf("%s\n", commands[i].usage);
+    }
+
+    Stream &stream;
+    Command commands[MAX_COMMANDS]{};
+    size_t count = 0;
+    char line[MAX_LINE]{};
+    size_t length = 0;
+};
+
+
+#endif //CONSOLE_HPP
@@ -0,0 +1,169 @@
+#ifndef HEALTH_MONITOR_HPP
+#define HEALTH_MONITOR_HPP
+
+#include <Arduino.h>
+#include <atomic>
+#include <functional>
+#include "Clock.hpp"
+
+#if CONFIG_IDF_TARGET_ARCH_XTENSA
+#include <esp_debug_helpers.h>
+#include <freertos/task_snapshot.h>
+#include <freertos/xtensa_context.h>
+#endif
+
+
+/*
+ * Watches registered subsystems for missed deadlines. Each subsystem reports heartbeats from its task and
+ * is checked from a dedicated monitor task; a heartbeat older than the deadline is recorded as an SLO
+ * violation together with the state and stack headroom of every watched task and a backtrace of the late
+ * one, and the subsystem's recovery callback runs once per violation. Subsystems that legitimately stop,
+ * like the audio path when nothing is streamed, report idle() and are not checked until their next
+ * heartbeat.
+ */
+class HealthMonitor {
+    static constexpr size_t MAX_ENTRIES = 8;
+    static constexpr int BACKTRACE_DEPTH = 16;
+public:
+    using Recovery = std::function<void()>;
+
+    struct Entry {
+        const char *name = nullptr;
+        uint32_t deadline = 0;
+        Recovery recovery{};
+        std::atomic<uint32_t> lastBeat{0};
+        std::atomic<bool> active{false};
+        std::atomic<TaskHandle_t> task{nullptr};
+        bool violated = false;
+        uint32_t violations = 0;
+        uint32_t worstMillis = 0;
+    };
+
+    // Registers a subsystem, returns its id for beat() and idle() or -1 if all entries are taken
+    int add(const char *name, uint32_t deadlineMillis, Recovery recovery = nullptr) {
+        if (count == MAX_ENTRIES) return -1;
+        auto &entry = entries[count];
+        entry.name = name;
+        entry.deadline = deadlineMillis;
+        entry.recovery = std::move(recovery);
+        return static_cast<int>(count++);
+    }
+
+    void beat(int id) {
+        if (id < 0) return;
+        auto &entry = entries[id];
+        entry.lastBeat.store(Clock::millis(), std::memory_order_relaxed);
+        if (!entry.task.load(std::memory_order_relaxed)) entry.task = xTaskGetCurrentTaskHandle();
+        entry.active.store(true, std::memory_order_release);
+    }
+
+    void idle(int id) {
+        if (id >= 0) entries[id].active.store(false, std::memory_order_release);
+    }
+
+    // Starts the monitor task checking all subsystems every period
+    bool begin(uint32_t periodMillis = 100, UBaseType_t priority = 2, BaseType_t core = tskNO_AFFINITY,
+               uint32_t stack = 3072) {
+        period = periodMillis;
+        return xTaskCreatePinnedToCore(run, "health", stack, this, priority, &handle, core) == pdPASS;
+    }
+
+    void check(uint32_t now) {
+        for (size_t i = 0; i < count; ++i) {
+            auto &entry = entries[i];
+            const auto late = now - entry.lastBeat.load(std::memory_order_relaxed);
+            if (!entry.active.load(std::memory_order_acquire) || late <= entry.deadline) {
+                entry.violated = false;
+                continue;
+            }
+            entry.worstMillis = std::max(entry.worstMillis, late);
+            if (entry.violated) continue;
+            entry.violated = true;
+            entry.violations++;
+            log_e("SLO violation: %s missed its %lu ms deadline by %lu ms", entry.name, entry.deadline,
+                  late - entry.deadline);
+            logTasks();
+            logBacktrace(entry.task.load(std::memory_order_relaxed));
+            if (entry.recovery) {
+                log_w("Recovering %s", entry.name);
+                entry.recovery();
+            }
+        }
+    }
+
+    void report() const {
+        for (size_t i = 0; i < count; ++i) {
+            const auto &entry = entries[i];
+            log_i("Health %s: %lu violations, worst %lu ms of %lu ms", entry.name, entry.violations,
+                  entry.worstMillis, entry.deadline);
+        }
+    }
+
+    const Entry &getEntry(int id) const { return entries[id]; }
+
+    TaskHandle_t getTask() const { return handle; }
+
+private:
+    static void run(void *arg) {
+        const auto monitor = static_cast<HealthMonitor *>(arg);
+        auto wake = xTaskGetTickCount();
+        for (;;) {
+            vTaskDelayUntil(&wake, pdMS_TO_TICKS(monitor->period));
+            monitor->check(Clock::millis());
+        }
+    }
+
+    void logTasks() const {
+        static constexpr const char *STATES[] = {"running", "ready", "blocked", "suspended", "deleted", "invalid"};
+        for (size_t i = 0; i < count; ++i) {
+            const auto task = entries[i].task.load(std::memory_order_relaxed);
+            if (!task) continue;
+            const auto state = eTaskGetState(task);
+            log_e("  %-10s task %-12s %-9s priority %u, %u bytes stack left", entries[i].name,
+                  pcTaskGetTaskName(task), STATES[std::min<size_t>(state, 5)], uxTaskPriorityGet(task),
+                  uxTaskGetStackHighWaterMark(task));
+        }
+    }
+
+    /*
+     * Prints the call stack the task was switched out with, in the format of a panic backtrace so the
+     * exception decoder resolves it. The walk reads the task's stack while it may be resumed on the other
+     * core; the backtrace code checks every frame, so at worst the trace ends marked as corrupted.
+     */
+    static void logBacktrace(TaskHandle_t task) {
+        if (!task) return;
+        if (task == xTaskGetCurrentTaskHandle() || eTaskGetState(task) == eRunning) {
+            log_e("  %s is running, no backtrace", pcTaskGetTaskName(task));
+            return;
+        }
+#if CONFIG_IDF_TARGET_ARCH_XTENSA
+        TaskSnapshot_t snapshot{};
+        vTaskGetSnapshot(task, &snapshot);
+        // Tasks preempted by an interrupt saved an exception frame, tasks that blocked a solicited one
+        const auto exception = static_cast<const XtExcFrame *>(snapshot.pxTopOfStack);
+        const auto solicited = static_cast<const XtSolFrame *>(snapshot.pxTopOfStack);
+        esp_backtrace_frame_t frame{};
+        if (exception->exit) {
+            frame.pc = exception->pc;
+            frame.sp = exception->a1;
+            frame.next_pc = exception->a0;
+        } else {
+            frame.pc = solicited->pc;
+            frame.sp = solicited->a1;
+            frame.next_pc = solicited->a0;
+        }
+        log_e("  %s backtrace:", pcTaskGetTaskName(task));
+        esp_backtrace_print_from_frame(BACKTRACE_DEPTH, &frame, false);
+#else
+        log_e("  No backtrace of %s on this target", pcTaskGetTaskName(task));
+#endif
+    }
+
+    Entry entries[MAX_ENTRIES]{};
+    size_t count = 0;
+    uint32_t period = 100;
+    TaskHandle_t handle = nullptr;
+};
+
+
+#endif //HEALTH_MONITOR_HPP
@@ -0,0 +1,87 @@
+#ifndef LINK_MONITOR_HPP
+#define LINK_MONITOR_HPP
+
+#include <cstddef>
+#include <cstdint>
+
+
+/*
+ * Tracks the quality of the Bluetooth link and picks the jitter buffer depth from it. The controller
+ * reports the RSSI as a delta to its golden receive range in dB, 0 being inside the range. Late audio
+ * callbacks, where the sink delivered nothing for longer than the buffer covers, are the loss indicator.
+ *
+ * Every WINDOW the smoothed RSSI and the late callbacks of the window are evaluated: a late callback or an
+ * RSSI below the depth's minimum steps one depth deeper right away, the buffer only gets shallower after
+ * STABLE_WINDOWS clean windows with the RSSI HYSTERESIS above the shallower depth's minimum.
+ */
+class LinkMonitor {
+public:
+    struct Depth {
+        int8_t minRssi;           /* Lowest smoothed RSSI delta this depth applies to in dB */
+        uint8_t prefetchPercent;  /* Jitter buffer filled before output starts */
+    };
+
+    static constexpr Depth DEPTHS[] = {
+            {0, 25},
+            {-6, 50},
+            {-12, 75},
+            {INT8_MIN, 90},
+    };
+    static constexpr int8_t HYSTERESIS = 3;
+    static constexpr uint32_t WINDOW = 5000;
+    static constexpr uint8_t STABLE_WINDOWS = 3;
+
+    struct Metrics {
+        float rssi = 0.0f;        /* Smoothed RSSI delta in dB */
+        int8_t lastRssi = 0;
+        uint32_t readings = 0;
+        uint32_t late = 0;        /* Late callbacks since boot */
+        uint32_t lateWindow = 0;  /* Late callbacks in the last window */
+        uint32_t changes = 0;     /* Depth changes since boot */
+    };
+
+    // Feeds an RSSI delta reading, may be called from the Bluetooth task
+    void onRssi(int8_t delta) {
+        metrics.rssi = metrics.readings++ ? metrics.rssi + (delta - metrics.rssi) * 0.2f : delta;
+        metrics.lastRssi = delta;
+    }
+
+    // Feeds the late callback count since boot, returns true if the depth changed
+    bool update(uint32_t late, uint32_t now) {
+        if (now - windowStart < WINDOW) return false;
+        windowStart = now;
+        metrics.lateWindow = late - metrics.late;
+        metrics.late = late;
+        const auto rssi = metrics.rssi;
+        auto next = level;
+        if (metrics.lateWindow || rssi < DEPTHS[level].minRssi) {
+            stable = 0;
+            if (next + 1 < LEVELS) next++;
+        } else if (next > 0 && ++stable >= STABLE_WINDOWS &&
+                   rssi >= static_cast<float>(DEPTHS[next - 1].minRssi + HYSTERESIS)) {
+            stable = 0;
+            next--;
+        }
+        if (next == level) return false;
+        level = next;
+        metrics.changes++;
+        return true;
+    }
+
+    const Depth &depth() const { return DEPTHS[level]; }
+
+    size_t getLevel() const { return level; }
+
+    const Metrics &getMetrics() const { return metrics; }
+
+private:
+    static constexpr size_t LEVELS = sizeof(DEPTHS) / sizeof(DEPTHS[0]);
+
+    size_t level = 1;
+    uint8_t stable = 0;
+    uint32_t windowStart = 0;
+    Metrics metrics{};
+};
+
+
+#endif //LINK_MONITOR_HPP
@@ -0,0 +1,90 @@
+#ifndef MEMORY_HPP
+#define MEMORY_HPP
+
+#include <Arduino.h>
+#include <esp_heap_caps.h>
+
+
+/*
+ * Capability-aware buffer allocation. Hot buffers stay in internal RAM, while large latency-tolerant buffers
+ * go to PSRAM if the board has it, keeping internal RAM free for the Bluetooth controller. I2S writes copy
+ * into the driver's own DMA descriptors, so no buffer here needs DMA-capable memory. Every allocation is
+ * recorded for the boot-time budget report.
+ */
+namespace mem {
+
+enum class Placement : uint8_t {
+    INTERNAL,  /* Internal, accessed on every block or atomically */
+    LARGE,     /* PSRAM if available, internal otherwise */
+};
+
+struct Allocation {
+    const char *name;
+    size_t size;
+    Placement placement;
+    bool external;
+};
+
+namespace detail {
+constexpr size_t MAX_ALLOCATIONS = 16;
+
+inline Allocation allocations[MAX_ALLOCATIONS]{};
+inline size_t count = 0;
+
+inline uint32_t caps(Placement placement) {
+    return placement == Placement::LARGE ? MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT : MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT;
+}
+}
+
+// Allocates zeroed memory for the lifetime of the firmware, returns nullptr if no suitable memory is left
+inline void *allocate(size_t size, Placement placement, const char *name, size_t alignment = 4) {
+    auto ptr = heap_caps_aligned_calloc(alignment, 1, size, detail::caps(placement));
+    auto external = ptr != nullptr && placement == Placement::LARGE;
+    if (!ptr && placement == Placement::LARGE) {
+        ptr = heap_caps_aligned_calloc(alignment, 1, size, detail::caps(Placement::INTERNAL));
+    }
+    if (!ptr) {
+        log_e("Allocating %u bytes for %s failed", size, name);
+        return nullptr;
+    }
+    if (detail::count < detail::MAX_ALLOCATIONS) {
+        detail::allocations[detail::count++] = {name, size, placement, external};
+    }
+    return ptr;
+}
+
+template<typename T>
+T *allocate(size_t count, Placement placement, const char *name, size_t alignment = alignof(T)) {
+    return static_cast<T *>(allocate(count * sizeof(T), placement, name, std::max<size_t>(alignment, 4)));
+}
+
+// Logs every recorded allocation and the remaining heap per memory type
+inline void report() {
+    size_t internal = 0, external = 0;
+    for (size_t i = 0; i < detail::count; ++i) {
+        const auto &a = detail::allocations[i];
+        (a.external ? external : internal) += a.size;
+        log_i("  %-16s %7u bytes in %s", a.name, a.size, a.external ? "PSRAM" : "internal RAM");
+    }
+    log_i("Buffers: %u bytes internal, %u bytes PSRAM", internal, external);
+    constexpr struct {
+        const char *name;
+        uint32_t caps;
+    } HEAPS[] = {
+            {"internal", MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT},
+            {"DMA", MALLOC_CAP_DMA},
+            {"PSRAM", MALLOC_CAP_SPIRAM},
+    };
+    for (const auto &heap: HEAPS) {
+        const auto total = heap_caps_get_total_size(heap.caps);
+        if (!total) continue;
+        log_i("Heap %-8s %7u free of %7u bytes, largest block %7u, minimum free %7u", heap.name,
+              heap_caps_get_free_size(heap.caps), total, heap_caps_get_largest_free_block(heap.caps),
+              heap_caps_get_minimum_free_size(heap.caps));
+    }
+}
+
+}
+
+
+#endif //MEMORY_HPP
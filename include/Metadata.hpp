@@ -0,0 +1,52 @@
+#ifndef METADATA_HPP
+#define METADATA_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <esp_avrc_api.h>
+#include "AvrcPayload.hpp"
+
+
+struct Metadata {
+    static constexpr size_t MAX_TEXT = 64;      /* Longest stored title, artist or album in bytes */
+    static constexpr size_t MAX_PAYLOAD = 512;  /* Longest attribute payload ever inspected */
+
+    esp_avrc_playback_stat_t playing = ESP_AVRC_PLAYBACK_STOPPED;
+    char title[MAX_TEXT] = "Unknown";
+    char artist[MAX_TEXT] = "Unknown";
+    char album[MAX_TEXT] = "Unknown";
+    uint32_t playtime = 0;
+    uint32_t position = 0;
+    uint8_t volume = 0;
+
+    void onAttribute(uint8_t id, const uint8_t *data, size_t length = MAX_PAYLOAD) {
+        switch (id) {
+            case ESP_AVRC_MD_ATTR_TITLE:
+                avrc::copyText(title, sizeof(title), data, length);
+                break;
+            case ESP_AVRC_MD_ATTR_ARTIST:
+                avrc::copyText(artist, sizeof(artist), data, length);
+                break;
+            case ESP_AVRC_MD_ATTR_ALBUM:
+                avrc::copyText(album, sizeof(album), data, length);
+                break;
+            case ESP_AVRC_MD_ATTR_PLAYING_TIME:
+                if (!avrc::parseUnsigned(data, length, playtime)) playtime = 0;
+                break;
+            default:
+                break;
+        }
+    }
+
+    void onVolume(int value) { volume = static_cast<uint8_t>(value < 0 ? 0 : value > 0x7F ? 0x7F : value); }
+
+    void onPosition(uint32_t value) { position = value; }
+
+    void onPlayStatus(esp_avrc_playback_stat_t status) {
+        playing = status <= ESP_AVRC_PLAYBACK_REV_SEEK || status == ESP_AVRC_PLAYBACK_ERROR
+                  ? status : ESP_AVRC_PLAYBACK_ERROR;
+    }
+};
+
+
+#endif //METADATA_HPP
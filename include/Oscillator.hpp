@@ -0,0 +1,155 @@
+#ifndef OSCILLATOR_HPP
+#define OSCILLATOR_HPP
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include "Pipeline.hpp"
+
+
+namespace dsp {
+
+// Full sine period with one guard entry so interpolation never wraps
+class SineTable {
+public:
+    static constexpr size_t BITS = 8;
+    static constexpr size_t SIZE = size_t{1} << BITS;
+
+    static const int16_t *get() {
+        static const auto table = [] {
+            std::array<int16_t, SIZE + 1> values{};
+            for (size_t i = 0; i <= SIZE; ++i) {
+                values[i] = static_cast<int16_t>(
+                        std::lrint(32767.0 * std::sin(2.0 * M_PI * static_cast<double>(i) / SIZE)));
+            }
+            return values;
+        }();
+        return table.data();
+    }
+};
+
+// Phase accumulator oscillator reading the sine table with linear interpolation
+class Oscillator {
+public:
+    void setFrequency(float frequency, float sampleRate) {
+        step = static_cast<uint32_t>(static_cast<double>(frequency) / sampleRate * 4294967296.0);
+    }
+
+    void reset() { phase = 0; }
+
+    int16_t next() {
+        const auto table = SineTable::get();
+        const auto index = phase >> (32 - SineTable::BITS);
+        const auto fraction = static_cast<int32_t>((phase >> (16 - SineTable::BITS)) & 0xFFFF);
+        const int32_t a = table[index];
+        const int32_t b = table[index + 1];
+        phase += step;
+        return static_cast<int16_t>(a + (((b - a) * fraction) >> 16));
+    }
+
+private:
+    uint32_t phase = 0;
+    uint32_t step = 0;
+};
+
+// Pink noise from white noise rows updated at halving rates (Voss-McCartney), falling 3 dB per octave
+class PinkNoise {
+    static constexpr uint32_t ROWS = 12;
+public:
+    int16_t next() {
+        const auto row = static_cast<uint32_t>(__builtin_ctz(++counter | (1u << ROWS)));
+        if (row < ROWS) {
+            sum -= rows[row];
+            rows[row] = white();
+            sum += rows[row];
+        }
+        return static_cast<int16_t>((sum + white()) / static_cast<int32_t>(ROWS + 1));
+    }
+
+private:
+    int32_t white() {
+        seed = seed * 1664525u + 1013904223u;
+        return static_cast<int16_t>(seed >> 16);
+    }
+
+    int32_t rows[ROWS]{};
+    int32_t sum = 0;
+    uint32_t counter = 0;
+    uint32_t seed = 22222;
+};
+
+struct Tone {
+    uint16_t frequency;  /* 0 for a pause */
+    uint16_t millis;
+};
+
+// Sequence of tones mixed into the output, each tone is ramped in and out to avoid clicks
+class Cue {
+    static constexpr uint32_t RAMP_MILLIS = 3;
+public:
+    template<size_t N>
+    Cue(const Tone (&tones)[N], float level) : Cue(tones, N, level) {}
+
+    // Tones outside the program image, e.g. from the asset store, have to stay mapped while the cue exists
+    Cue(const Tone *tones, size_t count, float level) : tones(tones), count(count),
+                                                        level(static_cast<int32_t>(level * 32768.0f)) {}
+
+    void start(float rate) {
+        sampleRate = rate;
+        index = 0;
+        begin();
+    }
+
+    void stop() { index = count; }
+
+    bool active() const { return index < count; }
+
+    // Adds the cue to count interleaved stereo frames, saturating
+    template<typename T>
+    void mix(T *frames, size_t n) {
+        using Traits = SampleTraits<T>;
+        for (size_t i = 0; i < n && active(); ++i, frames += 2) {
+            if (tones[index].frequency) {
+                const auto ramp = std::min(std::min(position, length - position), rampLength);
+                const auto value = static_cast<int16_t>(static_cast<int32_t>(oscillator.next()) * level / 32768 *
+                                                        static_cast<int32_t>(ramp) /
+                                                        static_cast<int32_t>(rampLength));
+                T sample;
+                convert(&value, &sample, 1);
+                frames[0] = Traits::saturate(static_cast<typename Traits::acc_t>(frames[0]) + sample);
+                frames[1] = Traits::saturate(static_cast<typename Traits::acc_t>(frames[1]) + sample);
+            }
+            if (++position >= length) {
+                index++;
+                begin();
+            }
+        }
+    }
+
+private:
+    void begin() {
+        position = 0;
+        if (!active()) return;
+        length = std::max<uint32_t>(1, static_cast<uint32_t>(tones[index].millis * sampleRate / 1000.0f));
+        rampLength = std::max<uint32_t>(1, static_cast<uint32_t>(RAMP_MILLIS * sampleRate / 1000.0f));
+        oscillator.setFrequency(tones[index].frequency, sampleRate);
+        oscillator.reset();
+    }
+
+    const Tone *tones;
+    size_t count;
+    int32_t level;
+    size_t index = SIZE_MAX;
+    uint32_t position = 0;
+    uint32_t length = 0;
+    uint32_t rampLength = 1;
+    float sampleRate = 44100.0f;
+    Oscillator oscillator{};
+};
+
+}
+
+
+#endif //OSCILLATOR_HPP
@@ -0,0 +1,225 @@
+#ifndef OTA_UPDATER_HPP
+#define OTA_UPDATER_HPP
+
+#include <Arduino.h>
+#include <HTTPClient.h>
+#include <esp32/rom/miniz.h>
+#include <esp_ota_ops.h>
+#include <mbedtls/sha256.h>
+
+
+/*
+ * Firmware updates into the inactive slot of the A/B partition table. Images are packed by
+ * scripts/ota_image.py as a Header followed by the zlib compressed firmware; the stream is inflated with the
+ * ROM inflater through a 32 KiB window while it arrives and written to flash as it is decompressed, so
+ * neither the compressed nor the plain image is ever held in RAM. The plain image is checked against the
+ * size and SHA-256 of the header and validated by the OTA layer before the slot is made bootable.
+ *
+ * A new image boots pending verification and is only marked valid by confirm() once it ran long enough,
+ * a crash or reset before that rolls back to the previous slot.
+ */
+namespace ota {
+
+class Updater {
+public:
+    static constexpr uint32_t MAGIC = 0x4F4B5053;  /* "SPKO" little endian */
+
+    struct __attribute__((packed)) Header {
+        uint32_t magic;
+        uint32_t size;            /* Plain image bytes */
+        uint32_t compressedSize;  /* zlib stream bytes following the header */
+        uint8_t sha256[32];       /* Of the plain image */
+    };
+
+    enum class Error : uint8_t { NONE, HEADER, SLOT, MEMORY, BEGIN, INFLATE, WRITE, SIZE, DIGEST, END, BOOT };
+
+    struct Stats {
+        uint32_t received;  /* Compressed bytes including the header */
+        uint32_t written;   /* Plain bytes written to flash */
+        uint32_t millis;
+    };
+
+    ~Updater() { abort(); }
+
+    // Prepares an update, the next write() starts with the header
+    bool begin() {
+        abort();
+        slot = esp_ota_get_next_update_partition(nullptr);
+        if (!slot) return fail(Error::SLOT);
+        inflater = static_cast<tinfl_decompressor *>(malloc(sizeof(tinfl_decompressor)));
+        window = static_cast<uint8_t *>(malloc(TINFL_LZ_DICT_SIZE));
+        if (!inflater || !window) return fail(Error::MEMORY);
+        tinfl_init(inflater);
+        mbedtls_sha256_init(&sha);
+        mbedtls_sha256_starts(&sha, 0);
+        headerBytes = 0;
+        windowOffset = 0;
+        stats = {0, 0, millis()};
+        error = Error::NONE;
+        active = true;
+        return true;
+    }
+
+    // Feeds the next bytes of the update image
+    bool write(const uint8_t *data, size_t length) {
+        if (!active) return false;
+        stats.received += length;
+        if (headerBytes < sizeof(Header)) {
+            const auto n = std::min(length, sizeof(Header) - headerBytes);
+            memcpy(reinterpret_cast<uint8_t *>(&header) + headerBytes, data, n);
+            headerBytes += n;
+            data += n;
+            length -= n;
+            if (headerBytes < sizeof(Header)) return true;
+            if (header.magic != MAGIC || header.size > slot->size) return fail(Error::HEADER);
+            if (esp_ota_begin(slot, header.size, &handle) != ESP_OK) return fail(Error::BEGIN);
+            log_i("Updating %s with %u bytes, %u compressed", slot->label, header.size, header.compressedSize);
+        }
+        return inflate(data, length, stats.received - sizeof(Header) < header.compressedSize);
+    }
+
+    // Verifies the written image and makes its slot boot next
+    bool end() {
+        if (!active) return false;
+        if (headerBytes < sizeof(Header) || stats.written != header.size) return fail(Error::SIZE);
+        uint8_t digest[32];
+        mbedtls_sha256_finish(&sha, digest);
+        if (memcmp(digest, header.sha256, sizeof(digest)) != 0) return fail(Error::DIGEST);
+        const auto ended = esp_ota_end(handle);
+        handle = 0;
+        if (ended != ESP_OK) return fail(Error::END);
+        if (esp_ota_set_boot_partition(slot) != ESP_OK) return fail(Error::BOOT);
+        stats.millis = millis() - stats.millis;
+        release();
+        return true;
+    }
+
+    void abort() {
+        if (handle) esp_ota_abort(handle);
+        handle = 0;
+        release();
+    }
+
+    Error getError() const { return error; }
+
+    const char *errorName() const {
+        static constexpr const char *NAMES[] = {"none", "invalid header", "no update slot", "out of memory",
+                                                "begin failed", "corrupt stream", "flash write failed",
+                                                "size mismatch", "SHA-256 mismatch", "invalid image",
+                                                "setting boot slot failed"};
+        return NAMES[static_cast<size_t>(error)];
+    }
+
+    const Stats &getStats() const { return stats; }
+
+private:
+    bool inflate(const uint8_t *data, size_t length, bool more) {
+        const auto flags = TINFL_FLAG_PARSE_ZLIB_HEADER | (more ? TINFL_FLAG_HAS_MORE_INPUT : 0);
+        tinfl_status status;
+        do {
+            auto in = length;
+            auto out = static_cast<size_t>(TINFL_LZ_DICT_SIZE - windowOffset);
+            status = tinfl_decompress(inflater, data, &in, window, window + windowOffset, &out, flags);
+            data += in;
+            length -= in;
+            if (out > 0) {
+                if (esp_ota_write(handle, window + windowOffset, out) != ESP_OK) return fail(Error::WRITE);
+                mbedtls_sha256_update(&sha, window + windowOffset, out);
+                stats.written += out;
+                windowOffset = (windowOffset + out) & (TINFL_LZ_DICT_SIZE - 1);
+            }
+        } while (status == TINFL_STATUS_HAS_MORE_OUTPUT || (status == TINFL_STATUS_NEEDS_MORE_INPUT && length));
+        if (status < TINFL_STATUS_DONE || (status == TINFL_STATUS_DONE && length)) return fail(Error::INFLATE);
+        return true;
+    }
+
+    bool fail(Error value) {
+        error = value;
+        log_e("Update failed: %s", errorName());
+        abort();
+        return false;
+    }
+
+    void release() {
+        if (active) mbedtls_sha256_free(&sha);
+        free(inflater);
+        free(window);
+        inflater = nullptr;
+        window = nullptr;
+        active = false;
+    }
+
+    const esp_partition_t *slot = nullptr;
+    esp_ota_handle_t handle = 0;
+    tinfl_decompressor *inflater = nullptr;
+    uint8_t *window = nullptr;
+    size_t windowOffset = 0;
+    mbedtls_sha256_context sha{};
+    Header header{};
+    size_t headerBytes = 0;
+    Stats stats{};
+    Error error = Error::NONE;
+    bool active = false;
+};
+
+constexpr uint32_t PULL_TIMEOUT_MS = 10000;  /* Longest wait for the next bytes of a download */
+
+// Downloads an update image over HTTP into the updater, the network has to be up
+inline bool pull(Updater &updater, const char *url) {
+    HTTPClient http;
+    http.setTimeout(PULL_TIMEOUT_MS);
+    if (!http.begin(url)) return false;
+    const auto code = http.GET();
+    if (code != HTTP_CODE_OK) {
+        log_e("Update download failed: HTTP %d", code);
+        http.end();
+        return false;
+    }
+    auto &stream = *http.getStreamPtr();
+    auto remaining = http.getSize();
+    uint8_t buffer[1024];
+    auto ok = updater.begin();
+    auto lastData = millis();
+    while (ok && http.connected() && (remaining > 0 || remaining == -1)) {
+        const auto available = stream.available();
+        if (!available) {
+            // A server that keeps the connection open without sending would block the caller forever
+            if (millis() - lastData > PULL_TIMEOUT_MS) {
+                log_e("Update download stalled for %u ms", PULL_TIMEOUT_MS);
+                updater.abort();
+                ok = false;
+                break;
+            }
+            delay(1);
+            continue;
+        }
+        const auto n = stream.readBytes(buffer, std::min<size_t>(available, sizeof(buffer)));
+        ok = updater.write(buffer, n);
+        if (remaining > 0) remaining -= static_cast<int>(n);
+        lastData = millis();
+    }
+    http.end();
+    if (!ok || !updater.end()) return false;
+    const auto &stats = updater.getStats();
+    const auto rate = static_cast<float>(stats.received) / static_cast<float>(std::max<uint32_t>(stats.millis, 1));
+    log_i("Update of %u bytes (%u received) written in %u ms, %.1f kB/s", stats.written, stats.received,
+          stats.millis, rate);
+    return true;
+}
+
+// Marks a freshly updated image valid once it ran for validMillis, call from the loop
+inline void confirm(uint32_t now, uint32_t validMillis) {
+    static bool confirmed = false;
+    if (confirmed || now < validMillis) return;
+    confirmed = true;
+    esp_ota_img_states_t state;
+    if (esp_ota_get_state_partition(esp_ota_get_running_partition(), &state) != ESP_OK) return;
+    if (state != ESP_OTA_IMG_PENDING_VERIFY) return;
+    esp_ota_mark_app_valid_cancel_rollback();
+    log_i("Updated firmware confirmed");
+}
+
+}
+
+
+#endif //OTA_UPDATER_HPP
@@ -0,0 +1,82 @@
+#ifndef PAIRING_CONTROLLER_HPP
+#define PAIRING_CONTROLLER_HPP
+
+#include <cstdint>
+#include <functional>
+
+
+/*
+ * Controls when the speaker can be found and connected. While PAIRING it is discoverable and connectable
+ * until a device connects or the discoverable window ends. IDLE keeps it connectable for known devices
+ * only and CONNECTED stops both scans, as the sink holds a single connection anyway.
+ */
+class PairingController {
+public:
+    enum class State : uint8_t { IDLE, PAIRING, CONNECTED };
+
+    // Applies the scan mode of the new state
+    using ScanCallback = std::function<void(bool connectable, bool discoverable)>;
+
+    struct Metrics {
+        uint32_t pairings = 0;
+        uint32_t timeouts = 0;
+        uint32_t lastPairingMillis = 0;  /* Time from entering pairing mode to the connection */
+    };
+
+    explicit PairingController(ScanCallback scan, uint32_t windowMillis = 120000)
+            : scan(std::move(scan)), windowMillis(windowMillis) {}
+
+    // Starts pairing right away if no device is known yet
+    void begin(bool paired, uint32_t now) {
+        if (paired) {
+            setState(State::IDLE);
+        } else {
+            startPairing(now);
+        }
+    }
+
+    void startPairing(uint32_t now) {
+        started = now;
+        setState(State::PAIRING);
+    }
+
+    // Returns true if the connection completed pairing
+    bool onConnected(uint32_t now) {
+        const auto paired = state == State::PAIRING;
+        if (paired) {
+            metrics.pairings++;
+            metrics.lastPairingMillis = now - started;
+        }
+        setState(State::CONNECTED);
+        return paired;
+    }
+
+    void onDisconnected() {
+        if (state == State::CONNECTED) setState(State::IDLE);
+    }
+
+    void loop(uint32_t now) {
+        if (state != State::PAIRING || now - started < windowMillis) return;
+        metrics.timeouts++;
+        setState(State::IDLE);
+    }
+
+    State getState() const { return state; }
+
+    const Metrics &getMetrics() const { return metrics; }
+
+private:
+    void setState(State value) {
+        state = value;
+        if (scan) scan(state != State::CONNECTED, state == State::PAIRING);
+    }
+
+    ScanCallback scan;
+    uint32_t windowMillis;
+    volatile State state = State::IDLE;
+    uint32_t started = 0;
+    Metrics metrics{};
+};
+
+
+#endif //PAIRING_CONTROLLER_HPP
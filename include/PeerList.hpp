@@ -0,0 +1,67 @@
+#ifndef PEER_LIST_HPP
+#define PEER_LIST_HPP
+
+#include <Preferences.h>
+#include <cstring>
+#include <esp_bt_defs.h>
+
+
+/*
+ * Most recently used list of paired devices persisted in NVS. The first entry is the peer connected last,
+ * next() walks the list from the current peer so repeated switches cycle through all known devices.
+ */
+class PeerList {
+public:
+    static constexpr const char *NAMESPACE = "peers";
+    static constexpr size_t MAX_PEERS = 4;
+
+    void load() {
+        Preferences prefs;
+        if (!prefs.begin(NAMESPACE, true)) return;
+        count = prefs.getBytes("mru", peers, sizeof(peers)) / sizeof(esp_bd_addr_t);
+        prefs.end();
+    }
+
+    // Moves the peer to the front of the list, saves the list if it changed
+    void remember(const uint8_t *peer) {
+        auto i = find(peer);
+        if (i == 0 && count > 0) return;
+        if (i == count) i = count < MAX_PEERS ? count++ : count - 1;
+        memmove(peers[1], peers[0], i * sizeof(esp_bd_addr_t));
+        memcpy(peers[0], peer, sizeof(esp_bd_addr_t));
+        save();
+    }
+
+    // The peer following the current one, the most recent if there is no current peer or nullptr if none
+    const uint8_t *next(const uint8_t *current) const {
+        if (count == 0) return nullptr;
+        if (!current) return peers[0];
+        const auto i = find(current);
+        if (i == count) return peers[0];
+        return count > 1 ? peers[(i + 1) % count] : nullptr;
+    }
+
+    size_t size() const { return count; }
+
+    const uint8_t *operator[](size_t i) const { return peers[i]; }
+
+private:
+    size_t find(const uint8_t *peer) const {
+        size_t i = 0;
+        while (i < count && memcmp(peers[i], peer, sizeof(esp_bd_addr_t)) != 0) i++;
+        return i;
+    }
+
+    void save() const {
+        Preferences prefs;
+        if (!prefs.begin(NAMESPACE, false)) return;
+        prefs.putBytes("mru", peers, count * sizeof(esp_bd_addr_t));
+        prefs.end();
+    }
+
+    esp_bd_addr_t peers[MAX_PEERS]{};
+    size_t count = 0;
+};
+
+
+#endif //PEER_LIST_HPP
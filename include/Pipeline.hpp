@@ -0,0 +1,683 @@
+#ifndef PIPELINE_HPP
+#define PIPELINE_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <mutex>
+#include <tuple>
+#include <type_traits>
+
+
+namespace dsp {
+
+/*
+ * Sample arithmetic for the supported sample formats. Fixed-point samples (int16_t as Q15, int32_t as Q31)
+ * use Q3.28 coefficients with a 64-bit accumulator, float samples use float coefficients. Coefficients must
+ * stay below COEF_MAX in magnitude, and the magnitudes summed into one accumulator below COEF_SUM_MAX so
+ * full-scale products cannot overflow it.
+ */
+template<typename T, typename = void>
+struct SampleTraits;
+
+template<typename T>
+struct SampleTraits<T, std::enable_if_t<std::is_integral_v<T>>> {
+    using coef_t = int32_t;
+    using acc_t = int64_t;
+    static constexpr int COEF_FRAC = 28;
+    static constexpr coef_t ONE = coef_t{1} << COEF_FRAC;
+    static constexpr float COEF_MAX = static_cast<float>(1 << (31 - COEF_FRAC));
+    static constexpr float COEF_SUM_MAX =
+            static_cast<float>(acc_t{1} << (63 - COEF_FRAC - std::numeric_limits<T>::digits));
+    static constexpr acc_t MAX = std::numeric_limits<T>::max();
+    static constexpr acc_t MIN = std::numeric_limits<T>::min();
+
+    static coef_t coef(float value) { return static_cast<coef_t>(lrintf(value * static_cast<float>(ONE))); }
+
+    static acc_t mac(acc_t acc, T sample, coef_t c) { return acc + static_cast<acc_t>(sample) * c; }
+
+    static T result(acc_t acc) { return saturate((acc + (acc_t{1} << (COEF_FRAC - 1))) >> COEF_FRAC); }
+
+    static T mul(T sample, coef_t c) { return result(static_cast<acc_t>(sample) * c); }
+
+    static T saturate(acc_t value) { return static_cast<T>(value > MAX ? MAX : value < MIN ? MIN : value); }
+
+    static T fromFloat(float value) { return saturate(static_cast<acc_t>(value * static_cast<float>(MAX))); }
+
+    static acc_t abs(T sample) { return sample < 0 ? -static_cast<acc_t>(sample) : sample; }
+};
+
+template<>
+struct SampleTraits<float> {
+    using coef_t = float;
+    using acc_t = float;
+    static constexpr coef_t ONE = 1.0f;
+    static constexpr float COEF_MAX = std::numeric_limits<float>::infinity();
+    static constexpr float COEF_SUM_MAX = std::numeric_limits<float>::infinity();
+    static constexpr acc_t MAX = 1.0f;
+    static constexpr acc_t MIN = -1.0f;
+
+    static coef_t coef(float value) { return value; }
+
+    static acc_t mac(acc_t acc, float sample, coef_t c) { return acc + sample * c; }
+
+    static float result(acc_t acc) { return acc; }
+
+    static float mul(float sample, coef_t c) { return sample * c; }
+
+    static float saturate(acc_t value) { return value > MAX ? MAX : value < MIN ? MIN : value; }
+
+    static float fromFloat(float value) { return value; }
+
+    static acc_t abs(float sample) { return std::fabs(sample); }
+};
+
+
+/*
+ * Stages process one interleaved stereo frame at a time in place. Every stage is a plain class template over
+ * the sample type so the pipeline can inline all stages into a single loop without any virtual dispatch.
+ *
+ * Setters called while the audio task runs the pipeline only publish the new value through an atomic, the
+ * stage applies it in beginBlock(), so a parameter never changes in the middle of a block and the audio path
+ * takes no lock. setSampleRate() and reset() are called by the audio task itself when the stream starts.
+ */
+struct Stage {
+    void setSampleRate(float) {}
+
+    void reset() {}
+
+    // Called on the audio path before every block, stages apply published parameter changes here
+    void beginBlock() {}
+};
+
+/*
+ * Lowers the level by a number of bits, BITS unless set, ahead of stages that may boost, so an equalizer band
+ * raising the level by up to 6 dB per bit does not clip before the limiter. A limiter given the same number
+ * of bits with setHeadroom() restores the level.
+ */
+template<typename T>
+class Headroom : public Stage {
+public:
+    static constexpr int BITS = 2;
+
+    void setBits(int value) { bits = value; }
+
+    int getBits() const { return bits; }
+
+    void operator()(T &l, T &r) const {
+        if constexpr (std::is_floating_point_v<T>) {
+            const auto scale = 1.0f / static_cast<float>(1 << bits);
+            l *= scale;
+            r *= scale;
+        } else {
+            l = static_cast<T>(l >> bits);
+            r = static_cast<T>(r >> bits);
+        }
+    }
+
+private:
+    int bits = BITS;
+};
+
+template<typename T>
+class MonoDownmix : public Stage {
+    using Traits = SampleTraits<T>;
+public:
+    void setEnabled(bool value) { nextEnabled.store(value, std::memory_order_relaxed); }
+
+    void beginBlock() { enabled = nextEnabled.load(std::memory_order_relaxed); }
+
+    void operator()(T &l, T &r) const {
+        if (!enabled) return;
+        if constexpr (std::is_floating_point_v<T>) {
+            l = r = (l + r) * 0.5f;
+        } else {
+            l = r = static_cast<T>((static_cast<typename Traits::acc_t>(l) + r) >> 1);
+        }
+    }
+
+private:
+    std::atomic<bool> nextEnabled{true};
+    bool enabled = true;
+};
+
+template<typename T>
+class Gain : public Stage {
+    using Traits = SampleTraits<T>;
+public:
+    void setGain(float linear) { nextGain.store(Traits::coef(linear), std::memory_order_relaxed); }
+
+    void beginBlock() { gain = nextGain.load(std::memory_order_relaxed); }
+
+    void operator()(T &l, T &r) const {
+        if (gain == Traits::ONE) return;
+        l = Traits::mul(l, gain);
+        r = Traits::mul(r, gain);
+    }
+
+private:
+    std::atomic<typename Traits::coef_t> nextGain{Traits::ONE};
+    typename Traits::coef_t gain = Traits::ONE;
+};
+
+// Source volume from 0 to 127 as sent over AVRCP, mapped to a quadratic taper
+template<typename T>
+class Volume : public Gain<T> {
+public:
+    void setVolume(uint8_t volume) {
+        const auto level = static_cast<float>(std::min<uint8_t>(volume, 0x7F)) / 127.0f;
+        this->setGain(level * level);
+    }
+};
+
+// Linear gain ramp for fading the output in and out without clicks, starting at the next block
+template<typename T>
+class Fade : public Stage {
+    using Traits = SampleTraits<T>;
+    using coef_t = typename Traits::coef_t;
+public:
+    void fadeTo(float level, float millis) {
+        nextLevel.store(level, std::memory_order_relaxed);
+        nextMillis.store(millis, std::memory_order_relaxed);
+        requested.store(true, std::memory_order_release);
+    }
+
+    void setSampleRate(float rate) { sampleRate = rate; }
+
+    void beginBlock() {
+        if (!requested.exchange(false, std::memory_order_acquire)) return;
+        const auto steps = static_cast<uint32_t>(nextMillis.load(std::memory_order_relaxed) * sampleRate / 1000.0f);
+        target = Traits::coef(nextLevel.load(std::memory_order_relaxed));
+        step = steps ? (target - gain) / static_cast<coef_t>(steps) : coef_t{};
+        remaining = steps;
+        if (!steps) gain = target;
+    }
+
+    void operator()(T &l, T &r) {
+        if (remaining && --remaining) {
+            gain += step;
+        } else {
+            gain = target;
+        }
+        if (gain == Traits::ONE) return;
+        l = Traits::mul(l, gain);
+        r = Traits::mul(r, gain);
+    }
+
+private:
+    coef_t gain = Traits::ONE;
+    coef_t target = Traits::ONE;
+    coef_t step{};
+    uint32_t remaining = 0;
+    float sampleRate = 44100.0f;
+    std::atomic<float> nextLevel{1.0f};
+    std::atomic<float> nextMillis{0.0f};
+    std::atomic<bool> requested{false};
+};
+
+struct Filter {
+    enum Type : uint8_t { NONE, LOW_PASS, HIGH_PASS, PEAKING, LOW_SHELF, HIGH_SHELF };
+    Type type = NONE;
+    float frequency = 1000.0f;
+    float q = 0.707f;
+    float gainDb = 0.0f;
+};
+
+// Normalized biquad coefficients following the RBJ audio EQ cookbook
+struct BiquadCoeffs {
+    float b0 = 1.0f, b1 = 0.0f, b2 = 0.0f, a1 = 0.0f, a2 = 0.0f;
+
+    static BiquadCoeffs design(const Filter &filter, float sampleRate) {
+        if (filter.type == Filter::NONE || sampleRate <= 0.0f) return {};
+        const auto A = std::pow(10.0f, filter.gainDb / 40.0f);
+        const auto w0 = 2.0f * static_cast<float>(M_PI) * filter.frequency / sampleRate;
+        const auto cosW = std::cos(w0);
+        const auto alpha = std::sin(w0) / (2.0f * filter.q);
+        const auto sqrtA = 2.0f * std::sqrt(A) * alpha;
+        float b0, b1, b2, a0, a1, a2;
+        switch (filter.type) {
+            case Filter::LOW_PASS:
+                b0 = b2 = (1.0f - cosW) / 2.0f;
+                b1 = 1.0f - cosW;
+                a0 = 1.0f + alpha;
+                a1 = -2.0f * cosW;
+                a2 = 1.0f - alpha;
+                break;
+            case Filter::HIGH_PASS:
+                b0 = b2 = (1.0f + cosW) / 2.0f;
+                b1 = -(1.0f + cosW);
+                a0 = 1.0f + alpha;
+                a1 = -2.0f * cosW;
+                a2 = 1.0f - alpha;
+                break;
+            case Filter::PEAKING:
+                b0 = 1.0f + alpha * A;
+                b1 = -2.0f * cosW;
+                b2 = 1.0f - alpha * A;
+                a0 = 1.0f + alpha / A;
+                a1 = -2.0f * cosW;
+                a2 = 1.0f - alpha / A;
+                break;
+            case Filter::LOW_SHELF:
+                b0 = A * ((A + 1.0f) - (A - 1.0f) * cosW + sqrtA);
+                b1 = 2.0f * A * ((A - 1.0f) - (A + 1.0f) * cosW);
+                b2 = A * ((A + 1.0f) - (A - 1.0f) * cosW - sqrtA);
+                a0 = (A + 1.0f) + (A - 1.0f) * cosW + sqrtA;
+                a1 = -2.0f * ((A - 1.0f) + (A + 1.0f) * cosW);
+                a2 = (A + 1.0f) + (A - 1.0f) * cosW - sqrtA;
+                break;
+            case Filter::HIGH_SHELF:
+                b0 = A * ((A + 1.0f) + (A - 1.0f) * cosW + sqrtA);
+                b1 = -2.0f * A * ((A - 1.0f) + (A + 1.0f) * cosW);
+                b2 = A * ((A + 1.0f) + (A - 1.0f) * cosW - sqrtA);
+                a0 = (A + 1.0f) - (A - 1.0f) * cosW + sqrtA;
+                a1 = 2.0f * ((A - 1.0f) - (A + 1.0f) * cosW);
+                a2 = (A + 1.0f) - (A - 1.0f) * cosW - sqrtA;
+                break;
+            default:
+                return {};
+        }
+        return {b0 / a0, b1 / a0, b2 / a0, a1 / a0, a2 / a0};
+    }
+};
+
+/*
+ * Cascade of up to MAX_BANDS direct form I biquads, bands without a filter type are skipped. Coefficients
+ * are designed on the thread changing a band into a spare bank and published through an atomic pointer;
+ * the audio path picks the bank up at the next block boundary and crossfades from the old to the new
+ * cascade over CROSSFADE_FRAMES, so retuning neither blocks nor clicks. Changes published during a
+ * crossfade are picked up once it has finished, only the latest of them. Banks still in use by the audio
+ * path are never overwritten, the mutex only serializes the threads changing bands.
+ *
+ * Bands are limited to MAX_GAIN_DB, which the Headroom stage in front of the equalizer absorbs, and to
+ * designs whose coefficients the sample format can hold. setBand() rejects anything else.
+ */
+template<typename T>
+class Equalizer : public Stage {
+    using Traits = SampleTraits<T>;
+    using coef_t = typename Traits::coef_t;
+    using acc_t = typename Traits::acc_t;
+public:
+    static constexpr size_t MAX_BANDS = 5;
+    static constexpr size_t CROSSFADE_FRAMES = 256;
+    static constexpr float MAX_GAIN_DB = 12.0f;
+
+    // Whether the filter is valid at the sample rate and its coefficients fit the sample format
+    static bool fits(const Filter &filter, float sampleRate) {
+        if (filter.type == Filter::NONE) return true;
+        if (!(filter.frequency > 0.0f && filter.frequency < sampleRate / 2.0f && filter.q > 0.0f)) return false;
+        if (!(std::fabs(filter.gainDb) <= MAX_GAIN_DB)) return false;
+        const auto c = BiquadCoeffs::design(filter, sampleRate);
+        float sum = 0.0f;
+        for (const auto value: {c.b0, c.b1, c.b2, c.a1, c.a2}) {
+            if (!std::isfinite(value) || std::fabs(value) >= Traits::COEF_MAX) return false;
+            sum += std::fabs(value);
+        }
+        return sum < Traits::COEF_SUM_MAX;
+    }
+
+    // Returns false and keeps the previous band if the filter does not fit at the current sample rate
+    bool setBand(size_t band, const Filter &filter) {
+        if (band >= MAX_BANDS) return false;
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!fits(filter, sampleRate)) return false;
+        filters[band] = filter;
+        publish();
+        return true;
+    }
+
+    Filter getBand(size_t band) const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return filters[band];
+    }
+
+    // Re-enabling starts the filters from silence, so stale history from before does not click
+    void setEnabled(bool value) { nextEnabled.store(value, std::memory_order_relaxed); }
+
+    void setSampleRate(float rate) {
+        std::lock_guard<std::mutex> lock(mutex);
+        sampleRate = rate;
+        publish();
+    }
+
+    void reset() {
+        for (auto &set: states) {
+            for (auto &state: set) state = {};
+        }
+    }
+
+    void beginBlock() {
+        const auto value = nextEnabled.load(std::memory_order_relaxed);
+        if (value && !enabled) reset();
+        enabled = value;
+        // Swapping during a crossfade would drop the bank faded from and step the output, the change waits
+        if (previous) return;
+        const auto next = pending.exchange(nullptr, std::memory_order_acq_rel);
+        if (!next) return;
+        previous = current;
+        current = next;
+        memcpy(states[live ^ 1], states[live], sizeof(states[live]));
+        live ^= 1;
+        weight = 0;
+        busy.store(mask(current) | mask(previous), std::memory_order_release);
+    }
+
+    void operator()(T &l, T &r) {
+        if (!enabled) return;
+        if (!previous) {
+            run(*current, states[live], l, r);
+            return;
+        }
+        auto pl = l, pr = r;
+        run(*previous, states[live ^ 1], pl, pr);
+        run(*current, states[live], l, r);
+        weight = std::min<coef_t>(weight + STEP, Traits::ONE);
+        l = mix(pl, l);
+        r = mix(pr, r);
+        if (weight < Traits::ONE) return;
+        previous = nullptr;
+        busy.store(mask(current), std::memory_order_release);
+    }
+
+private:
+    static constexpr coef_t STEP = Traits::ONE / static_cast<coef_t>(CROSSFADE_FRAMES);
+    // Current, previous and the last published bank may be in use, one is always free
+    static constexpr size_t BANKS = 4;
+
+    struct Coeffs {
+        coef_t b0, b1, b2, a1, a2;
+    };
+
+    struct Bank {
+        Coeffs coeffs[MAX_BANDS]{};
+        size_t active = 0;
+    };
+
+    struct History {
+        T x1{}, x2{}, y1{}, y2{};
+
+        T run(const Coeffs &c, T x) {
+            acc_t acc{};
+            acc = Traits::mac(acc, x, c.b0);
+            acc = Traits::mac(acc, x1, c.b1);
+            acc = Traits::mac(acc, x2, c.b2);
+            acc = Traits::mac(acc, y1, -c.a1);
+            acc = Traits::mac(acc, y2, -c.a2);
+            const auto y = Traits::result(acc);
+            x2 = x1;
+            x1 = x;
+            y2 = y1;
+            y1 = y;
+            return y;
+        }
+    };
+
+    struct State {
+        History left, right;
+    };
+
+    static void run(const Bank &bank, State *state, T &l, T &r) {
+        for (size_t i = 0; i < bank.active; ++i) {
+            l = state[i].left.run(bank.coeffs[i], l);
+            r = state[i].right.run(bank.coeffs[i], r);
+        }
+    }
+
+    T mix(T from, T to) const {
+        return Traits::result(Traits::mac(Traits::mac(acc_t{}, from, Traits::ONE - weight), to, weight));
+    }
+
+    uint8_t mask(const Bank *bank) const { return bank ? 1 << (bank - banks) : 0; }
+
+    /*
+     * Designs all bands into a bank the audio path does not use and publishes it, called with the mutex held.
+     * Bands which stopped fitting after a sample rate change are left out.
+     */
+    void publish() {
+        auto inUse = busy.load(std::memory_order_acquire);
+        if (!pending.exchange(nullptr, std::memory_order_acq_rel)) inUse |= mask(published);
+        size_t free = 0;
+        while (inUse & mask(&banks[free])) free++;
+        auto &bank = banks[free];
+        bank.active = 0;
+        for (const auto &filter: filters) {
+            if (filter.type == Filter::NONE || !fits(filter, sampleRate)) continue;
+            const auto c = BiquadCoeffs::design(filter, sampleRate);
+            bank.coeffs[bank.active++] = {Traits::coef(c.b0), Traits::coef(c.b1), Traits::coef(c.b2),
+                                          Traits::coef(c.a1), Traits::coef(c.a2)};
+        }
+        published = &bank;
+        pending.store(&bank, std::memory_order_release);
+    }
+
+    Filter filters[MAX_BANDS]{};
+    Bank banks[BANKS]{};
+    State states[2][MAX_BANDS]{};
+    const Bank *current = &banks[0];
+    const Bank *previous = nullptr;
+    const Bank *published = nullptr;
+    std::atomic<const Bank *> pending{nullptr};
+    std::atomic<uint8_t> busy{1};
+    std::atomic<bool> nextEnabled{true};
+    mutable std::mutex mutex{};
+    size_t live = 0;
+    coef_t weight = 0;
+    bool enabled = true;
+    float sampleRate = 44100.0f;
+};
+
+/*
+ * Peak limiter with instant attack and exponential release towards unity gain. Parameter changes take
+ * effect at the next block boundary. Behind a Headroom stage, setHeadroom() makes the limiter hold the
+ * ceiling relative to the reduced level and restore the level afterwards, which then cannot clip.
+ */
+template<typename T>
+class Limiter : public Stage {
+    using Traits = SampleTraits<T>;
+    using coef_t = typename Traits::coef_t;
+    using acc_t = typename Traits::acc_t;
+public:
+    void setCeiling(float value) { nextCeiling.store(Traits::fromFloat(std::fabs(value)), std::memory_order_relaxed); }
+
+    void setHeadroom(int bits) { nextHeadroom.store(bits, std::memory_order_relaxed); }
+
+    void setRelease(float millis) {
+        releaseMillis = millis;
+        update();
+    }
+
+    void setSampleRate(float rate) {
+        sampleRate = rate;
+        update();
+    }
+
+    void reset() { gain = Traits::ONE; }
+
+    void beginBlock() {
+        headroom = nextHeadroom.load(std::memory_order_relaxed);
+        ceiling = nextCeiling.load(std::memory_order_relaxed);
+        if constexpr (std::is_floating_point_v<T>) {
+            ceiling /= static_cast<float>(1 << headroom);
+        } else {
+            ceiling >>= headroom;
+        }
+        release = nextRelease.load(std::memory_order_relaxed);
+    }
+
+    void operator()(T &l, T &r) {
+        if (gain != Traits::ONE) {
+            if constexpr (std::is_floating_point_v<T>) {
+                gain += (Traits::ONE - gain) * release;
+            } else {
+                gain += static_cast<coef_t>((static_cast<acc_t>(Traits::ONE - gain) * release) >> Traits::COEF_FRAC);
+                if (Traits::ONE - gain < 2) gain = Traits::ONE;
+            }
+        }
+        // Checked after the release step, so the released gain cannot carry a peak over the ceiling
+        const auto peak = std::max(Traits::abs(l), Traits::abs(r));
+        if (Traits::abs(Traits::mul(Traits::saturate(peak), gain)) > ceiling) {
+            if constexpr (std::is_floating_point_v<T>) {
+                gain = ceiling / peak;
+            } else {
+                gain = static_cast<coef_t>((ceiling << Traits::COEF_FRAC) / peak);
+            }
+        }
+        if (gain != Traits::ONE) {
+            l = Traits::mul(l, gain);
+            r = Traits::mul(r, gain);
+        }
+        if (!headroom) return;
+        if constexpr (std::is_floating_point_v<T>) {
+            l *= static_cast<float>(1 << headroom);
+            r *= static_cast<float>(1 << headroom);
+        } else {
+            l = Traits::saturate(static_cast<acc_t>(l) * (acc_t{1} << headroom));
+            r = Traits::saturate(static_cast<acc_t>(r) * (acc_t{1} << headroom));
+        }
+    }
+
+private:
+    void update() {
+        const auto samples = releaseMillis.load() * sampleRate.load() / 1000.0f;
+        nextRelease.store(Traits::coef(samples > 1.0f ? 1.0f - std::exp(-1.0f / samples) : 1.0f),
+                          std::memory_order_relaxed);
+    }
+
+    acc_t ceiling = Traits::MAX;
+    coef_t gain = Traits::ONE;
+    coef_t release = Traits::ONE;
+    int headroom = 0;
+    std::atomic<int> nextHeadroom{0};
+    std::atomic<T> nextCeiling{static_cast<T>(Traits::MAX)};
+    std::atomic<coef_t> nextRelease{Traits::ONE};
+    std::atomic<float> releaseMillis{50.0f};
+    std::atomic<float> sampleRate{44100.0f};
+};
+
+
+// Converts count samples between formats, widening integer samples by shifting and narrowing by truncation
+template<typename From, typename To>
+void convert(const From *in, To *out, size_t count) {
+    if constexpr (std::is_same_v<From, To>) {
+        std::copy(in, in + count, out);
+    } else if constexpr (std::is_floating_point_v<To>) {
+        constexpr auto scale = 1.0f / (static_cast<float>(SampleTraits<From>::MAX) + 1.0f);
+        for (size_t i = 0; i < count; ++i) out[i] = static_cast<float>(in[i]) * scale;
+    } else if constexpr (std::is_floating_point_v<From>) {
+        for (size_t i = 0; i < count; ++i) out[i] = SampleTraits<To>::fromFloat(in[i]);
+    } else if constexpr (sizeof(To) > sizeof(From)) {
+        constexpr auto shift = (sizeof(To) - sizeof(From)) * 8;
+        for (size_t i = 0; i < count; ++i) out[i] = static_cast<To>(static_cast<To>(in[i]) * (To{1} << shift));
+    } else {
+        constexpr auto shift = (sizeof(From) - sizeof(To)) * 8;
+        for (size_t i = 0; i < count; ++i) out[i] = static_cast<To>(in[i] >> shift);
+    }
+}
+
+/*
+ * Reduces interleaved stereo Q31 samples to 16 bits with TPDF dither. With noise shaping the quantization
+ * error is fed back through a second order filter, (1 - z^-1)^2, moving the noise floor towards Nyquist
+ * where it is least audible.
+ */
+class Dither {
+    static constexpr int SHIFT = 16;
+public:
+    void setNoiseShaping(bool value) { shaping = value; }
+
+    void reset() { memset(error, 0, sizeof(error)); }
+
+    void process(const int32_t *in, int16_t *out, size_t frames) {
+        for (size_t i = 0; i < frames * 2; ++i) {
+            auto &e = error[i & 1];
+            int64_t value = in[i];
+            if (shaping) value -= 2 * static_cast<int64_t>(e[0]) - e[1];
+            const auto dithered = value + tpdf() + (int64_t{1} << (SHIFT - 1));
+            const auto quantized = SampleTraits<int16_t>::saturate(dithered >> SHIFT);
+            out[i] = quantized;
+            e[1] = e[0];
+            const auto residual = static_cast<int64_t>(quantized) * (int64_t{1} << SHIFT) - value;
+            e[0] = static_cast<int32_t>(std::clamp<int64_t>(residual, INT32_MIN, INT32_MAX));
+        }
+    }
+
+private:
+    // Sum of two uniform values spanning one 16-bit LSB each, from a linear congruential generator
+    int32_t tpdf() {
+        seed = seed * 1664525u + 1013904223u;
+        const auto a = static_cast<int32_t>(seed >> 16) & 0xFFFF;
+        const auto b = static_cast<int32_t>(seed) & 0xFFFF;
+        return a + b - 0xFFFF;
+    }
+
+    int32_t error[2][2]{};
+    uint32_t seed = 22222;
+    bool shaping = true;
+};
+
+
+/*
+ * Processing chain composed from stage templates at compile time. process() runs all stages per frame in a
+ * single pass over the block, processChained() runs each stage over the whole block in turn for comparison.
+ */
+template<typename T, template<typename> class... Stages>
+class Pipeline {
+public:
+    using sample_type = T;
+
+    template<template<typename> class S>
+    S<T> &get() { return std::get<S<T>>(stages); }
+
+    void setSampleRate(float rate) {
+        std::apply([rate](auto &... stage) { (stage.setSampleRate(rate), ...); }, stages);
+    }
+
+    void reset() {
+        std::apply([](auto &... stage) { (stage.reset(), ...); }, stages);
+    }
+
+    // Processes count interleaved stereo frames in place
+    void process(T *frames, size_t count) {
+        beginBlock();
+        for (size_t i = 0; i < count; ++i, frames += 2) {
+            std::apply([frames](auto &... stage) { (stage(frames[0], frames[1]), ...); }, stages);
+        }
+    }
+
+    // Processes count interleaved stereo frames from in into out, widening them to T in the same pass
+    template<typename In>
+    void process(const In *in, T *out, size_t count) {
+        beginBlock();
+        for (size_t i = 0; i < count; ++i, in += 2, out += 2) {
+            convert(in, out, 2);
+            std::apply([out](auto &... stage) { (stage(out[0], out[1]), ...); }, stages);
+        }
+    }
+
+    void processChained(T *frames, size_t count) {
+        beginBlock();
+        std::apply([frames, count](auto &... stage) { (run(stage, frames, count), ...); }, stages);
+    }
+
+private:
+    void beginBlock() {
+        std::apply([](auto &... stage) { (stage.beginBlock(), ...); }, stages);
+    }
+
+    template<typename S>
+    static void run(S &stage, T *frames, size_t count) {
+        for (size_t i = 0; i < count; ++i, frames += 2) {
+            stage(frames[0], frames[1]);
+        }
+    }
+
+    std::tuple<Stages<T>...> stages;
+};
+
+}
+
+
+#endif //PIPELINE_HPP
@@ -0,0 +1,256 @@
+#ifndef PIPELINE_STREAM_HPP
+#define PIPELINE_STREAM_HPP
+
+#include <AudioTools.h>
+#include <driver/i2s.h>
+#include "AmpGate.hpp"
+#include "BlockPool.hpp"
+#include "CaptureTap.hpp"
+#include "Clock.hpp"
+#include "HealthMonitor.hpp"
+#include "Oscillator.hpp"
+#include "Pipeline.hpp"
+
+
+/*
+ * Audio stream placed between the A2DP sink and the output stream which runs every block of 16-bit stereo
+ * PCM through a compile-time composed dsp::Pipeline. This is the only virtual call per block, the stages
+ * themselves are fused into a single loop. The chain may process at a higher resolution than the sink
+ * delivers, the result is written as Out samples, dithered when reducing 32-bit processing to 16 bits.
+ *
+ * The stream tracks the processing cost per sample against a budget; the output itself is checked bit for
+ * bit against golden files on the host, see test/test_golden.
+ *
+ * Cues are mixed in after the chain, so they stay audible while the music is faded out. While the sink is
+ * not streaming, pump() feeds silence through the stream so a cue still reaches the output. The sink's task
+ * and pump() claim the stream through an atomic flag, whoever holds it processes the block and updates the
+ * gate; a cue passed to play() is started by the claiming side at the next block, so no block takes a lock.
+ *
+ * With an amplifier gate, silent blocks are withheld while the amplifier is shut down. The last withheld
+ * block is kept as pre-roll and written ahead of the first audible block when the amplifier wakes up.
+ *
+ * All blocks come from a preallocated BlockPool, so the steady-state audio path performs no heap
+ * operations. If the pool is exhausted the block is dropped and counted.
+ *
+ * Each block is widened from the sink's PCM in the same pass that runs the chain, narrowed in place if the
+ * output is 16 bits, and handed from the pool to i2s_write when an output port is set. That is one fewer
+ * intermediate copy than a separate conversion pass, not zero copy: the legacy driver still copies every
+ * block into its DMA descriptors, sized to FRAMES so each block fills exactly one. trafficBytes counts the
+ * bytes these passes read and write, the driver's copy included; it is a count, not a measurement. The
+ * benchmark firmware times both paths as path_separate_convert and path_widening.
+ *
+ * A capture tap receives copies of the sink's blocks or shares the output blocks as they go to I2S.
+ */
+template<typename Chain, typename Out = typename Chain::sample_type>
+class PipelineStream : public audio_tools::AudioStream {
+    using In = int16_t;
+    using T = typename Chain::sample_type;
+    static constexpr bool DITHER = std::is_same_v<T, int32_t> && std::is_same_v<Out, int16_t>;
+    static_assert(DITHER || std::is_same_v<T, Out> || std::is_floating_point_v<T>,
+                  "Output must have the processing resolution or be dithered from 32 to 16 bits");
+    static constexpr uint32_t IDLE_MILLIS = 50;
+    static constexpr uint32_t LATE_MICROS = 20000;
+public:
+    static constexpr size_t FRAMES = 256;
+    static constexpr size_t BLOCK_BYTES = FRAMES * 2 * sizeof(T);
+    static_assert(sizeof(Out) <= sizeof(T), "Blocks are narrowed in place");
+
+    struct Metrics {
+        uint64_t samples = 0;
+        float nsPerSample = 0.0f;
+        float maxNsPerSample = 0.0f;
+        uint32_t overBudget = 0;
+        uint32_t dropped = 0;
+        uint32_t maxGapMicros = 0;
+        uint32_t late = 0;  /* Gaps between blocks above LATE_MICROS while streaming */
+        uint64_t trafficBytes = 0;
+    };
+
+    PipelineStream(audio_tools::AudioStream &out, Chain &chain, BlockPool &pool)
+            : out(out), chain(chain), pool(pool) {}
+
+    void setAudioInfo(audio_tools::AudioInfo info) override {
+        audio_tools::AudioStream::setAudioInfo(info);
+        chain.setSampleRate(static_cast<float>(info.sample_rate));
+        chain.reset();
+        info.bits_per_sample = sizeof(Out) * 8;
+        out.setAudioInfo(info);
+    }
+
+    size_t write(const uint8_t *data, size_t len) override {
+        const auto now = Clock::micros();
+        if (gapReset.exchange(false, std::memory_order_acquire)) metrics.maxGapMicros = 0;
+        if (now - lastWriteMicros < IDLE_MILLIS * 1000) {
+            metrics.maxGapMicros = std::max(metrics.maxGapMicros, now - lastWriteMicros);
+            if (now - lastWriteMicros > LATE_MICROS) metrics.late++;
+        }
+        lastWriteMicros = now;
+        lastWrite = Clock::millis();
+        // Only contended when the sink resumes while pump() is processing a block of silence
+        while (writing.exchange(true, std::memory_order_acquire)) delay(1);
+        const auto result = process(data, len);
+        writing.store(false, std::memory_order_release);
+        return result;
+    }
+
+    int availableForWrite() override { return out.availableForWrite(); }
+
+    // Mixes the cue into the output from the next block, the cue must stay alive until it finished playing
+    void play(dsp::Cue &value) { nextCue.store(&value, std::memory_order_release); }
+
+    bool playing() const {
+        return nextCue.load(std::memory_order_acquire) != nullptr || cue.load(std::memory_order_acquire) != nullptr;
+    }
+
+    void setGate(AmpGate &value) { gate = &value; }
+
+    void setNoiseShaping(bool value) { dither.setNoiseShaping(value); }
+
+    // Writes blocks directly to the I2S driver of the port instead of through the output stream
+    void setOutputPort(i2s_port_t value) { port = value; }
+
+    void setTap(CaptureTap &value) { tap = &value; }
+
+    // Reports a heartbeat per block to the monitor and idles the entry while the sink is not streaming
+    void setMonitor(HealthMonitor &value, int id) {
+        monitor = &value;
+        monitorId = id;
+    }
+
+    /*
+     * Writes a block of silence if a cue is playing but the sink stopped streaming, otherwise lets the gate
+     * see the silence. Call from the loop.
+     */
+    void pump() {
+        static const In silence[FRAMES * 2]{};
+        if (Clock::millis() - lastWrite <= IDLE_MILLIS) return;
+        if (writing.exchange(true, std::memory_order_acquire)) return;
+        if (monitor) monitor->idle(monitorId);
+        if (playing()) {
+            process(reinterpret_cast<const uint8_t *>(silence), sizeof(silence));
+        } else if (gate) {
+            gate->update(0, Clock::millis());
+        }
+        writing.store(false, std::memory_order_release);
+    }
+
+    // Processing cost in ns per sample above which a block is counted as over budget, 0 disables the check
+    void setBudget(float nsPerSample) { budget = nsPerSample; }
+
+    const Metrics &getMetrics() const { return metrics; }
+
+    void resetMetrics() { metrics = {}; }
+
+    // Restarts the worst gap between blocks with the next block, applied by the writing task
+    void resetGap() { gapReset.store(true, std::memory_order_release); }
+
+private:
+    // Called with the stream claimed through writing
+    size_t process(const uint8_t *data, size_t len) {
+        constexpr auto FRAME = sizeof(In) * 2;
+        if (const auto next = nextCue.exchange(nullptr, std::memory_order_acquire)) {
+            next->start(static_cast<float>(audioInfo().sample_rate));
+            cue.store(next, std::memory_order_release);
+        }
+        const auto samples = reinterpret_cast<const In *>(data);
+        for (size_t frame = 0; frame < len / FRAME; frame += FRAMES) {
+            const auto n = std::min(len / FRAME - frame, FRAMES);
+            auto block = pool.acquire();
+            if (!block) {
+                metrics.dropped++;
+                continue;
+            }
+            if (tap && tap->wants(CaptureTap::Point::RECEIVED)) capture(samples + frame * 2, n);
+            const auto buffer = block.template as<T>();
+            const auto start = ESP.getCycleCount();
+            chain.process(samples + frame * 2, buffer, n);
+            metrics.trafficBytes += n * 2 * (sizeof(In) + sizeof(T));
+            if (const auto current = cue.load(std::memory_order_relaxed)) {
+                current->mix(buffer, n);
+                if (!current->active()) cue.store(nullptr, std::memory_order_release);
+            }
+            if constexpr (DITHER) {
+                dither.process(buffer, block.template as<int16_t>(), n);
+            } else if constexpr (!std::is_same_v<T, Out>) {
+                dsp::convert(buffer, block.template as<Out>(), n * 2);
+            }
+            if constexpr (!std::is_same_v<T, Out>) metrics.trafficBytes += n * 2 * (sizeof(T) + sizeof(Out));
+            measure(ESP.getCycleCount() - start, n * 2);
+            block.setSize(n * 2 * sizeof(Out));
+            if (monitor) monitor->beat(monitorId);
+            if (gate) metrics.trafficBytes += block.size();
+            if (gate && !gate->update(peak(block.template as<Out>(), n * 2), Clock::millis())) {
+                preroll = std::move(block);
+                continue;
+            }
+            if (gate && gate->woke() && preroll) output(preroll);
+            preroll.reset();
+            output(block);
+        }
+        return len;
+    }
+
+    void output(const BlockPool::Ref &block) {
+        const auto data = block.template as<const uint8_t>();
+        metrics.trafficBytes += 2 * block.size();
+        if (tap) tap->push(CaptureTap::Point::PLAYED, block, sizeof(Out) * 8, audioInfo().sample_rate);
+        if (port == I2S_NUM_MAX) {
+            out.write(data, block.size());
+            return;
+        }
+        size_t written = 0;
+        i2s_write(port, data, block.size(), &written, portMAX_DELAY);
+    }
+
+    void capture(const In *samples, size_t frames) {
+        auto copy = pool.acquire();
+        if (copy) {
+            memcpy(copy.template as<In>(), samples, frames * 2 * sizeof(In));
+            copy.setSize(frames * 2 * sizeof(In));
+            metrics.trafficBytes += 2 * copy.size();
+        }
+        tap->push(CaptureTap::Point::RECEIVED, copy, sizeof(In) * 8, audioInfo().sample_rate);
+    }
+
+    // Block peak scaled to 16 bits
+    static int32_t peak(const Out *samples, size_t count) {
+        int32_t result = 0;
+        for (size_t i = 0; i < count; ++i) {
+            In sample;
+            dsp::convert(samples + i, &sample, 1);
+            result = std::max(result, std::abs(static_cast<int32_t>(sample)));
+        }
+        return result;
+    }
+
+    void measure(uint32_t cycles, size_t samples) {
+        const auto ns = static_cast<float>(cycles) * 1000.0f / static_cast<float>(getCpuFrequencyMhz()) /
+                        static_cast<float>(samples);
+        metrics.samples += samples;
+        metrics.nsPerSample += (ns - metrics.nsPerSample) * 0.01f;
+        metrics.maxNsPerSample = std::max(metrics.maxNsPerSample, ns);
+        if (budget > 0.0f && ns > budget) metrics.overBudget++;
+    }
+
+    audio_tools::AudioStream &out;
+    Chain &chain;
+    BlockPool &pool;
+    BlockPool::Ref preroll{};
+    dsp::Dither dither{};
+    AmpGate *gate = nullptr;
+    CaptureTap *tap = nullptr;
+    HealthMonitor *monitor = nullptr;
+    int monitorId = -1;
+    i2s_port_t port = I2S_NUM_MAX;
+    Metrics metrics{};
+    float budget = 0.0f;
+    std::atomic<dsp::Cue *> cue{nullptr};
+    std::atomic<dsp::Cue *> nextCue{nullptr};
+    volatile uint32_t lastWrite = 0;
+    uint32_t lastWriteMicros = 0;
+    std::atomic<bool> writing{false};
+    std::atomic<bool> gapReset{false};
+};
+
+
+#endif //PIPELINE_STREAM_HPP
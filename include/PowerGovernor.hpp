@@ -0,0 +1,78 @@
+#ifndef POWER_GOVERNOR_HPP
+#define POWER_GOVERNOR_HPP
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+
+
+/*
+ * Trades loudness for runtime as the battery discharges. The state of charge is estimated from the cell
+ * voltage and selects a policy limiting the output gain and limiter ceiling, whether optional DSP stages
+ * run and the CPU frequency. The estimate is smoothed over about 1 / SMOOTHING readings so a loud passage
+ * sagging the voltage does not switch policies, and levels only step back up once the charge exceeds the
+ * boundary by HYSTERESIS. That margin has to cover the voltage recovering under the lighter load of the
+ * quieter policy, around 20 mV through the cell resistance or 5 % on the flat part of the curve, otherwise
+ * the output pumps between two levels.
+ */
+class PowerGovernor {
+public:
+    struct Policy {
+        float minCharge;       /* Lowest state of charge this policy applies to, 0 to 1 */
+        float maxGain;         /* Linear gain applied on top of the source volume */
+        float limiterCeiling;  /* Linear peak ceiling of the limiter */
+        bool optionalDsp;      /* Whether optional stages like the equalizer run */
+        uint32_t cpuMhz;       /* CPU frequency, Bluetooth needs at least 80 MHz */
+    };
+
+    static constexpr Policy POLICIES[] = {
+            {0.50f, 1.000f, 1.000f, true, 240},
+            {0.25f, 0.794f, 0.891f, true, 240},
+            {0.10f, 0.631f, 0.708f, false, 160},
+            {0.00f, 0.501f, 0.501f, false, 80},
+    };
+    static constexpr float HYSTERESIS = 0.08f;
+    static constexpr float SMOOTHING = 0.1f;
+
+    // Open circuit voltage of a single Li-ion cell at 0 %, 10 %, ..., 100 % charge
+    static float stateOfCharge(float voltage) {
+        constexpr float OCV[] = {3.30f, 3.60f, 3.69f, 3.73f, 3.77f, 3.81f, 3.87f, 3.94f, 4.01f, 4.09f, 4.20f};
+        constexpr size_t N = sizeof(OCV) / sizeof(OCV[0]);
+        if (std::isnan(voltage) || voltage <= OCV[0]) return 0.0f;
+        if (voltage >= OCV[N - 1]) return 1.0f;
+        size_t i = 1;
+        while (voltage > OCV[i]) i++;
+        const auto fraction = (voltage - OCV[i - 1]) / (OCV[i] - OCV[i - 1]);
+        return (static_cast<float>(i - 1) + fraction) / static_cast<float>(N - 1);
+    }
+
+    // Feeds a new battery voltage, returns true if the active policy changed
+    bool update(float voltage) {
+        if (std::isnan(voltage)) return false;
+        const auto estimate = stateOfCharge(voltage);
+        charge = measured ? charge + (estimate - charge) * SMOOTHING : estimate;
+        measured = true;
+        auto next = level;
+        while (next + 1 < LEVELS && charge < POLICIES[next].minCharge) next++;
+        while (next > 0 && charge >= POLICIES[next - 1].minCharge + HYSTERESIS) next--;
+        if (next == level) return false;
+        level = next;
+        return true;
+    }
+
+    const Policy &policy() const { return POLICIES[level]; }
+
+    size_t getLevel() const { return level; }
+
+    float getCharge() const { return charge; }
+
+private:
+    static constexpr size_t LEVELS = sizeof(POLICIES) / sizeof(POLICIES[0]);
+
+    size_t level = 0;
+    float charge = 1.0f;
+    bool measured = false;
+};
+
+
+#endif //POWER_GOVERNOR_HPP
@@ -0,0 +1,110 @@
+#ifndef SELF_TEST_HPP
+#define SELF_TEST_HPP
+
+#include <AudioTools.h>
+#include "BatteryAdc.hpp"
+#include "Oscillator.hpp"
+#include "Pipeline.hpp"
+
+
+/*
+ * Production self-test writing test signals straight into the output stream: channel identification tones,
+ * a logarithmic sine sweep and pink noise, all from table-driven generators. The battery is measured idle
+ * and while the pink noise loads the amplifier; a cell or connection sagging too far under load fails the
+ * test. Whether each signal comes out of the right speaker is left to the operator, the report goes to the
+ * serial port as key=value lines prefixed with SELFTEST.
+ */
+template<typename Sample>
+class SelfTest {
+    static constexpr size_t FRAMES = 256;
+    static constexpr size_t BATTERY_READS = 16;  /* Battery readings per block while measuring */
+public:
+    struct Limits {
+        float minLoaded = 3.40f;  /* Lowest battery voltage under load in V */
+        float maxSag = 0.25f;     /* Largest drop from idle to load in V */
+    };
+
+    struct Report {
+        float idle;
+        float loaded;
+        bool passed;
+    };
+
+    SelfTest(audio_tools::AudioStream &out, BatteryAdc &battery, float sampleRate = 44100.0f, float level = 0.25f)
+            : out(out), battery(battery), sampleRate(sampleRate), level(static_cast<int32_t>(level * 32768.0f)) {}
+
+    void setLimits(const Limits &value) { limits = value; }
+
+    Report run() {
+        log_i("Self-test: channel identification");
+        dsp::Oscillator tone{};
+        tone.setFrequency(1000.0f, sampleRate);
+        play(1000, [&tone](int16_t &l, int16_t &) { l = tone.next(); });
+        play(1000, [&tone](int16_t &, int16_t &r) { r = tone.next(); });
+
+        log_i("Self-test: sine sweep 20 Hz to 20 kHz");
+        constexpr uint32_t SWEEP_MILLIS = 5000;
+        dsp::Oscillator sweep{};
+        uint32_t frame = 0;
+        const auto frames = static_cast<float>(SWEEP_MILLIS) * sampleRate / 1000.0f;
+        play(SWEEP_MILLIS, [&](int16_t &l, int16_t &r) {
+            if (frame++ % FRAMES == 0) sweep.setFrequency(20.0f * std::pow(1000.0f, frame / frames), sampleRate);
+            l = r = sweep.next();
+        });
+
+        log_i("Self-test: battery idle and under pink noise load");
+        play(500, [](int16_t &, int16_t &) {}, true);
+        const auto idle = voltage();
+        dsp::PinkNoise noise{};
+        play(3000, [&noise](int16_t &l, int16_t &r) { l = r = noise.next(); }, true);
+        const auto loaded = voltage();
+
+        const Report report{idle, loaded, loaded >= limits.minLoaded && idle - loaded <= limits.maxSag};
+        Serial.printf("SELFTEST battery_idle=%.3f\n", report.idle);
+        Serial.printf("SELFTEST battery_loaded=%.3f\n", report.loaded);
+        Serial.printf("SELFTEST battery_sag=%.3f\n", report.idle - report.loaded);
+        Serial.printf("SELFTEST result=%s\n", report.passed ? "PASS" : "FAIL");
+        return report;
+    }
+
+private:
+    // Plays the generated frames for the duration, optionally measuring the battery after every block
+    template<typename Generator>
+    void play(uint32_t millis, Generator &&generate, bool measure = false) {
+        int16_t frames[FRAMES * 2];
+        Sample samples[FRAMES * 2];
+        batterySum = 0;
+        batteryReads = 0;
+        auto remaining = static_cast<uint32_t>(static_cast<float>(millis) * sampleRate / 1000.0f);
+        while (remaining > 0) {
+            const auto n = std::min<uint32_t>(remaining, FRAMES);
+            for (size_t i = 0; i < n; ++i) {
+                int16_t l = 0, r = 0;
+                generate(l, r);
+                frames[2 * i] = static_cast<int16_t>(l * level / 32768);
+                frames[2 * i + 1] = static_cast<int16_t>(r * level / 32768);
+            }
+            dsp::convert(frames, samples, n * 2);
+            out.write(reinterpret_cast<const uint8_t *>(samples), n * 2 * sizeof(Sample));
+            remaining -= n;
+            if (!measure) continue;
+            for (size_t i = 0; i < BATTERY_READS; ++i) batterySum += battery.read();
+            batteryReads += BATTERY_READS;
+        }
+    }
+
+    float voltage() const {
+        return batteryReads ? static_cast<float>(batterySum) / static_cast<float>(batteryReads) / 1000.0f : NAN;
+    }
+
+    audio_tools::AudioStream &out;
+    BatteryAdc &battery;
+    float sampleRate;
+    int32_t level;
+    Limits limits{};
+    uint32_t batterySum = 0;
+    uint32_t batteryReads = 0;
+};
+
+
+#endif //SELF_TEST_HPP
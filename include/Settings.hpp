@@ -0,0 +1,29 @@
+#ifndef SETTINGS_HPP
+#define SETTINGS_HPP
+
+#include <Preferences.h>
+
+
+// Settings persisted in NVS across deep sleep and power cycles
+struct Settings {
+    static constexpr const char *NAMESPACE = "speaker";
+
+    uint8_t volume = 64;
+
+    void load() {
+        Preferences prefs;
+        if (!prefs.begin(NAMESPACE, true)) return;
+        volume = prefs.getUChar("volume", volume);
+        prefs.end();
+    }
+
+    void save() const {
+        Preferences prefs;
+        if (!prefs.begin(NAMESPACE, false)) return;
+        prefs.putUChar("volume", volume);
+        prefs.end();
+    }
+};
+
+
+#endif //SETTINGS_HPP
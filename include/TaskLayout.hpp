@@ -0,0 +1,78 @@
+#ifndef TASK_LAYOUT_HPP
+#define TASK_LAYOUT_HPP
+
+#include <Arduino.h>
+
+
+/*
+ * Core, priority and stack of every application-level task in one table. Tasks created by the firmware
+ * look their placement up when they are started; tasks created by libraries get their priority applied
+ * by name once they exist, their core has to be set through the library before it creates them. Priorities
+ * can be switched back to the ones the tasks had before at runtime to compare both; placing them on cores
+ * only happens at startup.
+ */
+namespace tasks {
+
+struct Placement {
+    const char *name;
+    BaseType_t core;       /* tskNO_AFFINITY to let the scheduler decide */
+    UBaseType_t priority;
+    uint32_t stack;        /* Bytes, 0 for tasks whose stack is set by their creator */
+};
+
+constexpr bool sameName(const char *a, const char *b) {
+    while (*a && *a == *b) {
+        a++;
+        b++;
+    }
+    return *a == *b;
+}
+
+// Finds the placement for a task in the layout, nullptr if the task is not part of it
+template<size_t N>
+constexpr const Placement *find(const Placement (&layout)[N], const char *name) {
+    for (const auto &placement: layout) {
+        if (sameName(placement.name, name)) return &placement;
+    }
+    return nullptr;
+}
+
+// Applies the priority of every task of the layout that already exists, keeping the one it had in stock
+template<size_t N>
+void apply(const Placement (&layout)[N], UBaseType_t (&stock)[N]) {
+    for (size_t i = 0; i < N; ++i) {
+        if (const auto task = xTaskGetHandle(layout[i].name)) {
+            if (!stock[i]) stock[i] = uxTaskPriorityGet(task);
+            vTaskPrioritySet(task, layout[i].priority);
+        }
+    }
+}
+
+// Puts back the priorities the tasks had before apply()
+template<size_t N>
+void restore(const Placement (&layout)[N], const UBaseType_t (&stock)[N]) {
+    for (size_t i = 0; i < N; ++i) {
+        const auto task = xTaskGetHandle(layout[i].name);
+        if (task && stock[i]) vTaskPrioritySet(task, stock[i]);
+    }
+}
+
+template<size_t N>
+void report(const Placement (&layout)[N]) {
+    for (const auto &placement: layout) {
+        const auto task = xTaskGetHandle(placement.name);
+        if (!task) {
+            log_i("Task %-12s not running", placement.name);
+            continue;
+        }
+        const auto core = xTaskGetAffinity(task);
+        log_i("Task %-12s core %s, priority %u, %u bytes stack left", placement.name,
+              core == tskNO_AFFINITY ? "any" : core ? "1" : "0", uxTaskPriorityGet(task),
+              uxTaskGetStackHighWaterMark(task));
+    }
+}
+
+}
+
+
+#endif //TASK_LAYOUT_HPP
@@ -0,0 +1,114 @@
+"""Collects the results of the benchmark firmware and compares them against a baseline.
+
+Flash the benchmark build and read its JSON lines from the serial port or a saved log:
+
+    pio run -e benchmark -t upload
+    python scripts/benchmark.py /dev/ttyUSB0 [--baseline FILE] [--update] [--json FILE]
+
+The minimum cycles per item of every benchmark are compared against benchmark_baseline.json; the script
+fails if one got slower than the tolerance, --update stores the results as the new baseline and --json
+writes them for further processing. The host benchmarks print ns per item instead of cycles, pass - to read
+them from stdin and keep them in a baseline of their own:
+
+    pio test -e native -f test_benchmark -v | python scripts/benchmark.py - --baseline benchmark_host.json
+"""
+import argparse
+import json
+import os
+import re
+import sys
+
+BASELINE = "benchmark_baseline.json"
+# Relative growth in cycles per item tolerated before the comparison fails
+TOLERANCE = 0.05
+JSON_RE = re.compile(r"\{.*\}")
+
+
+def collect(lines):
+    """Benchmark results by name until the firmware reports it is done."""
+    results = {}
+    for line in lines:
+        match = JSON_RE.search(line)
+        if not match:
+            continue
+        try:
+            result = json.loads(match.group(0))
+        except ValueError:
+            continue
+        if result.get("done"):
+            break
+        results[result["name"]] = result
+    return results
+
+
+def serial_lines(port, baud, timeout):
+    import serial
+    with serial.Serial(port, baud, timeout=timeout) as stream:
+        while True:
+            line = stream.readline()
+            if not line:
+                raise TimeoutError("no output from %s for %d s" % (port, timeout))
+            yield line.decode("utf-8", "replace")
+
+
+def compare(results, baseline):
+    print("%-24s %12s %12s %12s %9s" % ("benchmark", "cycles/item", "median", "ns/item", "change"))
+    slower = []
+    for name, result in results.items():
+        # Device results count cycles, host results only time ns
+        key = "cycles_min" if "cycles_min" in result else "ns_min"
+        then = baseline.get(name, {}).get(key) if baseline else None
+        change = ""
+        if then:
+            delta = result[key] / then - 1.0
+            change = "%+8.1f%%" % (delta * 100.0)
+            if delta > TOLERANCE:
+                slower.append((name, delta))
+        median = result.get("cycles_median", result.get("ns_median"))
+        print("%-24s %12s %12.2f %12.2f %9s" % (name, "%.2f" % result["cycles_min"] if key == "cycles_min" else "-",
+                                                median, result["ns_min"], change))
+    for name, delta in slower:
+        print("%s got %.1f %% slower, more than the tolerated %.0f %%" % (name, delta * 100.0, TOLERANCE * 100.0))
+    return 1 if slower else 0
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("source", help="serial port, saved serial log or - for stdin")
+    parser.add_argument("--baud", type=int, default=115200)
+    parser.add_argument("--timeout", type=int, default=30, help="seconds to wait for output")
+    parser.add_argument("--baseline", default=BASELINE)
+    parser.add_argument("--update", action="store_true", help="store the results as the new baseline")
+    parser.add_argument("--json", help="write the results to this file")
+    args = parser.parse_args()
+
+    if args.source == "-":
+        results = collect(sys.stdin)
+    elif os.path.isfile(args.source):
+        with open(args.source, encoding="utf-8", errors="replace") as file:
+            results = collect(file)
+    else:
+        results = collect(serial_lines(args.source, args.baud, args.timeout))
+    if not results:
+        print("No benchmark results found")
+        return 1
+    if args.json:
+        with open(args.json, "w", encoding="utf-8") as file:
+            json.dump(results, file, indent=2, sort_keys=True)
+            file.write("\n")
+    baseline = None
+    if os.path.isfile(args.baseline):
+        with open(args.baseline, encoding="utf-8") as file:
+            baseline = json.load(file)
+    status = compare(results, baseline)
+    if args.update:
+        with open(args.baseline, "w", encoding="utf-8") as file:
+            json.dump(results, file, indent=2, sort_keys=True)
+            file.write("\n")
+        print("Benchmark baseline written to %s" % args.baseline)
+        return 0
+    return status
+
+
+if __name__ == "__main__":
+    sys.exit(main())
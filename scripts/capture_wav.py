@@ -0,0 +1,128 @@
+"""Writes the PCM stream of a firmware built with -D PCM_CAPTURE=<point> to WAV files.
+
+Reads the framed stream from a serial port or a recorded file, resynchronizes on the frame magic, drops
+frames with a bad CRC and fills blocks dropped on the device with silence so the timing stays intact. A new
+file is started for every capture point and sample rate change:
+
+    python scripts/capture_wav.py /dev/ttyUSB0 [--baud 2000000] [--out capture]
+    python scripts/capture_wav.py recording.bin --out capture
+
+Log output interleaved with the frames is skipped. Stop a serial capture with Ctrl+C.
+"""
+import argparse
+import os
+import struct
+import sys
+import wave
+import zlib
+
+MAGIC = b"PCMC"
+HEADER = struct.Struct("<4sIIIHBB")
+CRC = struct.Struct("<I")
+POINTS = {1: "received", 2: "played"}
+
+
+class Output:
+    def __init__(self, prefix):
+        self.prefix = prefix
+        self.index = 0
+        self.key = None
+        self.wav = None
+        self.sequence = None
+        self.block = 0
+
+    def write(self, point, rate, bits, sequence, pcm):
+        key = (point, rate, bits)
+        if key != self.key:
+            self.close()
+            self.index += 1
+            name = "%s-%d-%s-%d.wav" % (self.prefix, self.index, POINTS.get(point, point), rate)
+            self.wav = wave.open(name, "wb")
+            self.wav.setnchannels(2)
+            self.wav.setsampwidth(bits // 8)
+            self.wav.setframerate(rate)
+            self.key = key
+            self.sequence = None
+            print("Writing %s" % name)
+        missing = 0
+        if self.sequence is not None and sequence > self.sequence:
+            missing = sequence - self.sequence
+            self.wav.writeframes(b"\0" * (missing * (self.block or len(pcm))))
+        self.block = len(pcm)
+        self.sequence = sequence + 1
+        self.wav.writeframes(pcm)
+        return missing
+
+    def close(self):
+        if self.wav:
+            self.wav.close()
+            self.wav = None
+
+
+def frames(read):
+    """Yields (header fields, pcm) of every valid frame and None for every corrupt one."""
+    buffer = b""
+    while True:
+        chunk = read()
+        if chunk is None:
+            return
+        buffer += chunk
+        while True:
+            start = buffer.find(MAGIC)
+            if start < 0:
+                buffer = buffer[-(len(MAGIC) - 1):]
+                break
+            buffer = buffer[start:]
+            if len(buffer) < HEADER.size:
+                break
+            header = HEADER.unpack_from(buffer)
+            end = HEADER.size + header[4] + CRC.size
+            if len(buffer) < end:
+                break
+            body = buffer[:end - CRC.size]
+            if CRC.unpack_from(buffer, end - CRC.size)[0] != zlib.crc32(body):
+                buffer = buffer[1:]
+                yield None
+                continue
+            buffer = buffer[end:]
+            yield header, body[HEADER.size:]
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("source", help="serial port or recorded file")
+    parser.add_argument("--baud", type=int, default=2000000)
+    parser.add_argument("--out", default="capture", help="prefix of the written WAV files")
+    args = parser.parse_args()
+
+    if os.path.isfile(args.source):
+        stream = open(args.source, "rb")
+        read = lambda: stream.read(65536) or None
+    else:
+        import serial
+        stream = serial.Serial(args.source, args.baud, timeout=1)
+        read = lambda: stream.read(max(1, stream.in_waiting))
+
+    output = Output(args.out)
+    valid = corrupt = missing = 0
+    dropped = 0
+    try:
+        for frame in frames(read):
+            if frame is None:
+                corrupt += 1
+                continue
+            (_, sequence, dropped, rate, _, bits, point), pcm = frame
+            missing += output.write(point, rate, bits, sequence, pcm)
+            valid += 1
+    except KeyboardInterrupt:
+        pass
+    finally:
+        output.close()
+        stream.close()
+    print("%d frames, %d corrupt, %d blocks missing (%d dropped on the device)" %
+          (valid, corrupt, missing, dropped))
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
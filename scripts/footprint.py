@@ -0,0 +1,167 @@
+"""Per-component IRAM, DRAM, BSS and flash footprint from the linker map.
+
+Used as a PlatformIO extra script it makes the linker write a map file, prints the breakdown after every
+build and adds two targets:
+
+    pio run -t footprint           report and fail if memory grew past the tolerance against the baseline
+    pio run -t footprint-baseline  store the current footprint as the new baseline
+
+It can also be run directly: python scripts/footprint.py <firmware.map> [--baseline FILE] [--update]
+"""
+import argparse
+import json
+import os
+import re
+import sys
+
+REGIONS = ("iram", "dram", "bss", "flash")
+SECTIONS = {
+    ".iram0.vectors": "iram",
+    ".iram0.text": "iram",
+    ".dram0.data": "dram",
+    ".dram0.bss": "bss",
+    ".noinit": "bss",
+    ".flash.appdesc": "flash",
+    ".flash.rodata": "flash",
+    ".flash.text": "flash",
+}
+# Growth in bytes per region tolerated before the footprint target fails
+TOLERANCE = {"iram": 512, "dram": 512, "bss": 1024, "flash": 16384}
+BASELINE = "footprint_baseline.json"
+
+OUTPUT_RE = re.compile(r"^(\.\S+)(?:\s+0x[0-9a-f]+\s+0x[0-9a-f]+.*)?$")
+INPUT_RE = re.compile(r"^ (\S+)(?:\s+0x([0-9a-f]+)\s+0x([0-9a-f]+)\s+(.+))?$")
+WRAPPED_RE = re.compile(r"^\s+0x([0-9a-f]+)\s+0x([0-9a-f]+)\s+(.+)$")
+
+
+def component(path):
+    """Archive name for library members, path below the build directory for project objects."""
+    path = path.strip()
+    match = re.match(r"^(.*\.a)\(.*\)$", path)
+    if match:
+        return os.path.basename(match.group(1))
+    match = re.search(r"\.pio/build/[^/]+/(.+)$", path.replace("\\", "/"))
+    return match.group(1) if match else os.path.basename(path)
+
+
+def parse(map_path):
+    result = {}
+    region = None
+    pending = None
+    with open(map_path, encoding="utf-8", errors="replace") as lines:
+        for line in lines:
+            if line.startswith("Linker script and memory map"):
+                break
+        for line in lines:
+            line = line.rstrip("\n")
+            output = OUTPUT_RE.match(line)
+            if output:
+                region = SECTIONS.get(output.group(1))
+                pending = None
+                continue
+            if region is None:
+                continue
+            entry = INPUT_RE.match(line)
+            if entry and not line.startswith("  "):
+                if entry.group(2) is None:
+                    pending = entry.group(1)
+                    continue
+                address, size, path = entry.group(2), entry.group(3), entry.group(4)
+            else:
+                wrapped = WRAPPED_RE.match(line) if pending else None
+                if not wrapped:
+                    continue
+                address, size, path = wrapped.groups()
+            pending = None
+            size = int(size, 16)
+            if size == 0 or int(address, 16) == 0:
+                continue
+            name = "*fill*" if path.startswith("*fill*") else component(path)
+            sizes = result.setdefault(name, dict.fromkeys(REGIONS, 0))
+            sizes[region] += size
+    return result
+
+
+def totals(footprint):
+    return {region: sum(sizes[region] for sizes in footprint.values()) for region in REGIONS}
+
+
+def report(footprint, baseline=None, limit=25):
+    rows = sorted(footprint.items(), key=lambda item: -sum(item[1].values()))
+    print("%-40s %9s %9s %9s %9s" % ("component", *REGIONS))
+    for name, sizes in rows[:limit]:
+        print("%-40s %9d %9d %9d %9d" % (name[:40], *(sizes[r] for r in REGIONS)))
+    if len(rows) > limit:
+        print("... %d more components" % (len(rows) - limit))
+    total = totals(footprint)
+    print("%-40s %9d %9d %9d %9d" % ("total", *(total[r] for r in REGIONS)))
+    if baseline is None:
+        return {}
+
+    zero = dict.fromkeys(REGIONS, 0)
+    changed = []
+    for name in sorted(set(footprint) | set(baseline)):
+        now, then = footprint.get(name, zero), baseline.get(name, zero)
+        delta = {r: now[r] - then.get(r, 0) for r in REGIONS}
+        if any(delta.values()):
+            changed.append((name, delta))
+    if changed:
+        print("\nChanges against baseline:")
+        for name, delta in sorted(changed, key=lambda item: -sum(abs(v) for v in item[1].values())):
+            print("%-40s %+9d %+9d %+9d %+9d" % (name[:40], *(delta[r] for r in REGIONS)))
+    growth = {r: total[r] - totals(baseline)[r] for r in REGIONS}
+    print("%-40s %+9d %+9d %+9d %+9d" % ("total", *(growth[r] for r in REGIONS)))
+    return {r: growth[r] for r in REGIONS if growth[r] > TOLERANCE[r]}
+
+
+def load(path):
+    if not os.path.isfile(path):
+        return None
+    with open(path, encoding="utf-8") as file:
+        return json.load(file)
+
+
+def store(footprint, path):
+    with open(path, "w", encoding="utf-8") as file:
+        json.dump(footprint, file, indent=2, sort_keys=True)
+        file.write("\n")
+    print("Footprint baseline written to %s" % path)
+
+
+def check(map_path, baseline_path):
+    exceeded = report(parse(map_path), load(baseline_path))
+    for region, growth in exceeded.items():
+        print("%s grew by %d bytes, more than the tolerated %d" % (region, growth, TOLERANCE[region]))
+    return 1 if exceeded else 0
+
+
+try:
+    Import("env")  # noqa: F821
+except NameError:
+    env = None
+
+if env is not None:
+    map_file = os.path.join(env.subst("$BUILD_DIR"), "firmware.map")
+    baseline_file = os.path.join(env.subst("$PROJECT_DIR"), BASELINE)
+    env.Append(LINKFLAGS=["-Wl,-Map," + map_file])
+
+    def after_build(source, target, env):
+        report(parse(map_file), load(baseline_file))
+
+    env.AddPostAction("$BUILD_DIR/${PROGNAME}.elf", after_build)
+    env.AddCustomTarget("footprint", "$BUILD_DIR/${PROGNAME}.elf",
+                        lambda *args, **kwargs: check(map_file, baseline_file),
+                        title="Footprint", description="Report memory footprint against the baseline")
+    env.AddCustomTarget("footprint-baseline", "$BUILD_DIR/${PROGNAME}.elf",
+                        lambda *args, **kwargs: store(parse(map_file), baseline_file),
+                        title="Footprint baseline", description="Store the current memory footprint")
+elif __name__ == "__main__":
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("map", help="linker map file")
+    parser.add_argument("--baseline", default=BASELINE, help="baseline JSON file")
+    parser.add_argument("--update", action="store_true", help="store the footprint as new baseline")
+    args = parser.parse_args()
+    if args.update:
+        store(parse(args.map), args.baseline)
+    else:
+        sys.exit(check(args.map, args.baseline))
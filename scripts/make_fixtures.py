@@ -0,0 +1,76 @@
+"""Generates the WAV fixtures the golden tests run through the audio chain.
+
+    python scripts/make_fixtures.py [--out test/data/fixtures]
+
+The signals are deterministic, so rerunning the script reproduces the checked-in files byte for byte. After
+changing a fixture or deliberately changing the chain's output, refresh the goldens with
+UPDATE_GOLDEN=1 pio test -e native -f test_golden and review the difference before committing them.
+"""
+import argparse
+import math
+import os
+import random
+import struct
+import sys
+import wave
+
+RATE = 44100
+FRAMES = 4096
+
+
+def sweep():
+    """Logarithmic sine sweep from 20 Hz to 20 kHz, the right channel 6 dB lower and inverted."""
+    frames = []
+    phase = 0.0
+    for i in range(FRAMES):
+        frequency = 20.0 * 1000.0 ** (i / FRAMES)
+        phase += 2.0 * math.pi * frequency / RATE
+        value = 0.9 * math.sin(phase)
+        frames.append((value, -0.5 * value))
+    return frames
+
+
+def noise():
+    """Full-scale uniform noise, independent per channel, driving the limiter."""
+    generator = random.Random(52)
+    return [(generator.uniform(-1.0, 1.0), generator.uniform(-1.0, 1.0)) for _ in range(FRAMES)]
+
+
+def bursts():
+    """A loud two-tone burst, silence and a quiet burst, exercising limiter attack and release."""
+    frames = []
+    for i in range(FRAMES):
+        t = i / RATE
+        value = 0.6 * math.sin(2.0 * math.pi * 100.0 * t) + 0.39 * math.sin(2.0 * math.pi * 5000.0 * t)
+        if i >= FRAMES * 3 // 4:
+            value *= 0.1
+        elif i >= FRAMES // 2:
+            value = 0.0
+        frames.append((value, value))
+    return frames
+
+
+def write(path, frames):
+    data = b"".join(struct.pack("<hh", *(max(-32768, min(32767, round(v * 32767.0))) for v in frame))
+                    for frame in frames)
+    with wave.open(path, "wb") as file:
+        file.setnchannels(2)
+        file.setsampwidth(2)
+        file.setframerate(RATE)
+        file.writeframes(data)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("--out", default=os.path.join("test", "data", "fixtures"))
+    args = parser.parse_args()
+    os.makedirs(args.out, exist_ok=True)
+    for name, generate in (("sweep", sweep), ("noise", noise), ("bursts", bursts)):
+        path = os.path.join(args.out, name + ".wav")
+        write(path, generate())
+        print(path)
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,90 @@
+"""Packs a firmware image for the OTA updater and optionally serves it to the speaker.
+
+    pio run
+    python scripts/ota_image.py .pio/build/dfrobot_firebeetle2_esp32e/firmware.bin [-o FILE] [--serve PORT]
+
+The image is the header read by ota::Updater (magic, plain size, compressed size and SHA-256 of the plain
+firmware, little endian) followed by the firmware as a zlib stream. --serve answers every GET with the
+image until interrupted, point the speaker's update command at http://<host>:<port>/.
+
+The firmware is checked against the smallest application slot of the partition table, partitions.csv by
+default, and refused if it does not fit; the updater would reject it only after the download.
+"""
+import argparse
+import hashlib
+import http.server
+import os
+import struct
+import sys
+import zlib
+
+MAGIC = 0x4F4B5053
+HEADER = struct.Struct("<III32s")
+PARTITIONS = os.path.join(os.path.dirname(os.path.abspath(__file__)), os.pardir, "partitions.csv")
+
+
+def slot_size(partitions):
+    """Size of the smallest application slot in a partition table CSV."""
+    sizes = []
+    with open(partitions, encoding="utf-8") as file:
+        for line in file:
+            fields = [field.strip() for field in line.split("#")[0].split(",")]
+            if len(fields) >= 5 and fields[1] == "app":
+                sizes.append(int(fields[4], 0))
+    if not sizes:
+        raise ValueError("no application slot in %s" % partitions)
+    return min(sizes)
+
+
+def pack(firmware):
+    compressed = zlib.compress(firmware, 9)
+    header = HEADER.pack(MAGIC, len(firmware), len(compressed), hashlib.sha256(firmware).digest())
+    return header + compressed
+
+
+def serve(image, port):
+    class Handler(http.server.BaseHTTPRequestHandler):
+        def do_GET(self):
+            self.send_response(200)
+            self.send_header("Content-Type", "application/octet-stream")
+            self.send_header("Content-Length", str(len(image)))
+            self.end_headers()
+            self.wfile.write(image)
+
+    server = http.server.HTTPServer(("", port), Handler)
+    print("Serving the update on port %d, stop with Ctrl+C" % port)
+    try:
+        server.serve_forever()
+    except KeyboardInterrupt:
+        pass
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("firmware", help="firmware.bin built by PlatformIO")
+    parser.add_argument("-o", "--output", help="image file, defaults to the firmware with .ota appended")
+    parser.add_argument("--serve", type=int, metavar="PORT", help="serve the image over HTTP")
+    parser.add_argument("--partitions", default=PARTITIONS, help="partition table the firmware has to fit")
+    args = parser.parse_args()
+
+    with open(args.firmware, "rb") as file:
+        firmware = file.read()
+    slot = slot_size(args.partitions)
+    print("%s: %d of %d bytes in the application slot (%.0f %%)" % (args.firmware, len(firmware), slot,
+                                                                   100.0 * len(firmware) / slot))
+    if len(firmware) > slot:
+        print("The firmware does not fit the application slot")
+        return 1
+    image = pack(firmware)
+    output = args.output or args.firmware + ".ota"
+    with open(output, "wb") as file:
+        file.write(image)
+    print("%s: %d bytes, %d packed (%.0f %%)" % (output, len(firmware), len(image),
+                                                 100.0 * len(image) / max(len(firmware), 1)))
+    if args.serve:
+        serve(image, args.serve)
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,127 @@
+"""Packs the assets directory into the blob read by AssetStore.
+
+Used as a PlatformIO extra script it packs assets/ into the build directory before every build and adds a
+target that writes the blob into the assets partition:
+
+    pio run -t uploadassets
+
+It can also be run directly: python scripts/pack_assets.py <directory> <output>
+
+Every file becomes an asset named by its path below the directory. Files ending in .tones hold one
+"frequency millis" pair per line and are packed as dsp::Tone arrays under their name without the suffix,
+all other files are stored as they are.
+"""
+import argparse
+import csv
+import os
+import struct
+import sys
+
+MAGIC = 0x414B5053
+VERSION = 1
+ALIGNMENT = 16
+MAX_NAME = 24
+HEADER = struct.Struct("<IHHII")
+ENTRY = struct.Struct("<%dsII" % MAX_NAME)
+SUBTYPE = 0x40
+LABEL = "assets"
+
+
+def tones(text):
+    """dsp::Tone array from "frequency millis" lines, # starts a comment."""
+    data = b""
+    for number, line in enumerate(text.splitlines(), 1):
+        fields = line.split("#", 1)[0].split()
+        if not fields:
+            continue
+        if len(fields) != 2:
+            raise ValueError("line %d: expected frequency and millis" % number)
+        data += struct.pack("<HH", int(fields[0]), int(fields[1]))
+    return data
+
+
+def collect(directory):
+    """Asset contents by name."""
+    assets = {}
+    for root, _, files in os.walk(directory):
+        for file_name in files:
+            path = os.path.join(root, file_name)
+            name = os.path.relpath(path, directory).replace(os.sep, "/")
+            with open(path, "rb") as file:
+                data = file.read()
+            if name.endswith(".tones"):
+                name = name[:-len(".tones")]
+                data = tones(data.decode("utf-8"))
+            if len(name.encode("utf-8")) >= MAX_NAME:
+                raise ValueError("asset name %s is longer than %d bytes" % (name, MAX_NAME - 1))
+            assets[name.encode("utf-8")] = data
+    return assets
+
+
+def align(offset):
+    return (offset + ALIGNMENT - 1) // ALIGNMENT * ALIGNMENT
+
+
+def pack(assets):
+    names = sorted(assets)
+    offset = align(HEADER.size + len(names) * ENTRY.size)
+    index = b""
+    body = b""
+    for name in names:
+        data = assets[name]
+        index += ENTRY.pack(name, offset, len(data))
+        padding = align(len(data)) - len(data)
+        body += data + b"\0" * padding
+        offset += len(data) + padding
+    head = HEADER.pack(MAGIC, VERSION, len(names), offset, 0) + index
+    return head + b"\0" * (align(len(head)) - len(head)) + body
+
+
+def partition(table):
+    """Offset and size of the assets partition in a partition table CSV."""
+    with open(table, encoding="utf-8") as file:
+        for row in csv.reader(line for line in file if not line.lstrip().startswith("#")):
+            fields = [field.strip() for field in row]
+            if len(fields) >= 5 and fields[0] == LABEL:
+                return int(fields[3], 0), int(fields[4], 0)
+    raise ValueError("no %s partition in %s" % (LABEL, table))
+
+
+def build(directory, output, capacity=None):
+    blob = pack(collect(directory) if os.path.isdir(directory) else {})
+    if capacity is not None and len(blob) > capacity:
+        raise ValueError("assets take %d bytes, the partition holds %d" % (len(blob), capacity))
+    with open(output, "wb") as file:
+        file.write(blob)
+    print("Assets: %d bytes%s" % (len(blob), " of %d" % capacity if capacity else ""))
+
+
+try:
+    Import("env")  # noqa: F821
+except NameError:
+    env = None
+
+if env is not None:
+    asset_dir = os.path.join(env.subst("$PROJECT_DIR"), "assets")
+    blob_file = os.path.join(env.subst("$BUILD_DIR"), "assets.bin")
+    table_file = os.path.join(env.subst("$PROJECT_DIR"), env.GetProjectOption("board_build.partitions"))
+    asset_offset, asset_size = partition(table_file)
+
+    def before_build(source, target, env):
+        build(asset_dir, blob_file, asset_size)
+
+    env.AddPreAction("$BUILD_DIR/${PROGNAME}.elf", before_build)
+    env.AddCustomTarget("uploadassets", None, [
+        lambda *args, **kwargs: build(asset_dir, blob_file, asset_size),
+        lambda *args, **kwargs: env.AutodetectUploadPort(),
+        '"$PYTHONEXE" "$UPLOADER" --chip esp32 --port "$UPLOAD_PORT" --baud $UPLOAD_SPEED write_flash '
+        "0x%x %s" % (asset_offset, blob_file),
+    ], title="Upload assets", description="Pack assets/ and write them to the assets partition")
+elif __name__ == "__main__":
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("directory", help="assets directory")
+    parser.add_argument("output", help="blob to write")
+    parser.add_argument("--partitions", help="partition table CSV to check the size against")
+    args = parser.parse_args()
+    size = partition(args.partitions)[1] if args.partitions else None
+    build(args.directory, args.output, size)
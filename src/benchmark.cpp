@@ -0,0 +1,30 @@
+#include <Arduino.h>
+#include "BenchmarkSuite.hpp"
+
+/*
+ * Benchmark firmware built by [env:benchmark] in place of main.cpp. Runs the DSP and control kernels of the
+ * speaker on the device with the firmware's compiler flags and prints the results as JSON lines, collect
+ * and compare them with scripts/benchmark.py.
+ */
+
+
+constexpr uint8_t BAT_VOLT = A4;    /* Battery voltage measurement */
+constexpr uint8_t BUT_LEFT = D6;    /* Left button */
+constexpr uint8_t BUT_RIGHT = D5;   /* Right button */
+constexpr uint8_t BUT_CENTER = D7;  /* Center button */
+
+constexpr float BAT_DIVIDER = 6.9f / (22.0f + 6.9f);
+
+
+void setup() {
+    Serial.begin(115200);
+    delay(2000);
+    bench::dspKernels();
+    bench::controlKernels({BAT_VOLT, BAT_DIVIDER, {BUT_LEFT, BUT_RIGHT, BUT_CENTER}});
+    bench::done();
+}
+
+
+void loop() {
+    delay(1000);
+}
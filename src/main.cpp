@@ -1,6 +1,15 @@
 #include <AudioTools.h>
-#include <BluetoothA2DPSink.h>
-#include "Button.hpp"
+#include <BluetoothA2DPSinkQueued.h>
+#include <WiFi.h>
+#include <freertos/ringbuf.h>
+#include "App.hpp"
+#include "AssetStore.hpp"
+#include "CaptureTap.hpp"
+#include "Console.hpp"
+#include "Memory.hpp"
+#include "OtaUpdater.hpp"
+#include "SelfTest.hpp"
+#include "TaskLayout.hpp"
 
 /* TODO
  *  - Implement automatic deep sleep when no audio is playing for a while
@@ -17,191 +26,259 @@ using namespace audio_tools;
 constexpr uint8_t I2S_BCK = D11;    /* Audio data bit clock */
 constexpr uint8_t I2S_LRC = D12;    /* Audio data left and right clock */
 constexpr uint8_t I2S_DIN = D10;    /* ESP32 audio data output (to speakers) */
+constexpr uint8_t AMP_SD = D2;      /* Amplifier shutdown (SD_MODE) */
 constexpr uint8_t BAT_VOLT = A4;    /* Battery voltage measurement */
 constexpr uint8_t BUT_LEFT = D6;    /* Left button */
 constexpr uint8_t BUT_RIGHT = D5;   /* Right button */
 constexpr uint8_t BUT_CENTER = D7;  /* Center button */
 
+constexpr float BAT_DIVIDER = 6.9f / (22.0f + 6.9f);  /* Nominal battery voltage divider factor */
+constexpr size_t SINK_RING_BYTES = 32 * 1024;  /* Sink jitter buffer, the library's default size */
+
+#ifndef PCM_CAPTURE
+#define PCM_CAPTURE 0  /* Capture point streamed to the host, see CaptureTap::Point */
+#endif
+constexpr uint32_t CAPTURE_BAUD = 2000000;  /* Serial rate while capturing */
+#ifndef PCM_CAPTURE_NARROW
+#define PCM_CAPTURE_NARROW 1  /* Capture 32-bit output as 16 bits so the port keeps up, 0 drops blocks instead */
+#endif
+
+#ifndef APPLY_TASK_LAYOUT
+#define APPLY_TASK_LAYOUT 1  /* 0 keeps the stock cores and priorities, the layout command still switches them */
+#endif
+
+constexpr tasks::Placement TASK_LAYOUT[] = {
+        {"BtI2STask", 1, configMAX_PRIORITIES - 3, 0},  /* I2S writer and DSP on the app core, with BtAppTask */
+        {"BtAppTask", 1, configMAX_PRIORITIES - 4, 0},  /* A2DP and AVRC event handling */
+        {"health", 0, 3, 3072},                         /* Health monitor, watches the app core */
+        {"loopTask", 1, 1, 0},                          /* Buttons, battery and logging */
+        {"capture", 0, 1, 3072},                        /* PCM capture, only with PCM_CAPTURE */
+};
+
+// The sink starts both of its tasks on the one core set through set_task_core()
+static_assert(tasks::find(TASK_LAYOUT, "BtI2STask")->core == tasks::find(TASK_LAYOUT, "BtAppTask")->core,
+              "BtI2STask and BtAppTask must share a core");
+
 constexpr auto META_FLAGS = ESP_AVRC_MD_ATTR_TITLE | ESP_AVRC_MD_ATTR_ARTIST |
                             ESP_AVRC_MD_ATTR_ALBUM | ESP_AVRC_MD_ATTR_PLAYING_TIME;
 
-float batteryVoltage = NAN;
-struct {
-    esp_avrc_playback_stat_t playing = ESP_AVRC_PLAYBACK_STOPPED;
-    String title = "Unknown";
-    String artist = "Unknown";
-    String album = "Unknown";
-    uint32_t playtime = 0;
-    uint32_t position = 0;
-    uint8_t volume = 0;
-} meta{};
+// Wi-Fi edge of the App, only up while an update downloads
+struct WifiStation {
+    void begin(const char *ssid, const char *password) {
+        WiFi.mode(WIFI_STA);
+        WiFi.begin(ssid, password);
+    }
 
-I2SStream out{};
-BluetoothA2DPSink bt{out};
+    bool connected() { return WiFi.status() == WL_CONNECTED; }
+};
 
-static void increaseVolume();
-static void nextTrack();
-static void decreaseVolume();
-static void previousTrack();
-static void changePlayState();
-static void enterPairingMode();
+// OTA edge of the App
+struct OtaFirmware {
+    bool pull(const char *url) {
+        ota::Updater updater{};
+        return ota::pull(updater, url);
+    }
+
+    void confirm(uint32_t now, uint32_t validMs) { ota::confirm(now, validMs); }
+};
+
+using Speaker = App<BluetoothA2DPSinkQueued, WifiStation, OtaFirmware>;
 
-Button left{BUT_LEFT, decreaseVolume, previousTrack};
-Button right{BUT_RIGHT, increaseVolume, nextTrack};
-Button center{BUT_CENTER, changePlayState, enterPairingMode};
+I2SStream out{};
+Speaker app{out, {AMP_SD, BAT_VOLT, BAT_DIVIDER, BUT_LEFT, BUT_RIGHT, BUT_CENTER}};
+auto &bt = app.sink;
+CaptureTap capture{Serial};
+Console console{Serial};
+bool taskLayout = APPLY_TASK_LAYOUT;
+UBaseType_t stockPriorities[sizeof(TASK_LAYOUT) / sizeof(TASK_LAYOUT[0])]{};
+A2DPNoVolumeControl sinkVolume{};
+AssetStore assets{};
+StaticRingbuffer_t *sinkRingControl = nullptr;
+uint8_t *sinkRingStorage = nullptr;
 
-static void measureBattery();
+static bool tuneEqualizer(int argc, char **argv);
+static bool tuneLimiter(int argc, char **argv);
+static bool updateFirmware(int argc, char **argv);
+static bool switchTaskLayout(int argc, char **argv);
 static void metadataCallback(uint8_t id, const uint8_t *data);
 static void connectionStateChangedCallback(esp_a2d_connection_state_t state, void *);
 
 
 void setup() {
+#if PCM_CAPTURE
+    Serial.setTxBufferSize(4096);
+    Serial.begin(CAPTURE_BAUD);
+#else
     Serial.begin(115200);
-    pinMode(BAT_VOLT, INPUT);
-    analogSetAttenuation(ADC_0db);
-
-    left.setup();
-    right.setup();
-    center.setup();
+#endif
+    if (assets.begin()) {
+        const auto cue = assets.find("cues/low_battery");
+        if (cue) app.lowBatteryCue = dsp::Cue{cue.as<dsp::Tone>(), cue.count<dsp::Tone>(), 0.5f};
+    }
 
     I2SConfig cfg{TX_MODE};
     cfg.pin_data = I2S_DIN;
     cfg.pin_bck = I2S_BCK;
     cfg.pin_ws = I2S_LRC;
     cfg.i2s_format = I2S_LSB_FORMAT;
-    cfg.buffer_count = 8;
-    cfg.buffer_size = 1024;
+    cfg.bits_per_sample = sizeof(OutputSample) * 8;
+    cfg.buffer_count = 16;
+    cfg.buffer_size = Speaker::Output::FRAMES;
     out.begin(cfg);
+    app.setup();
+    if (digitalRead(BUT_LEFT) == LOW && digitalRead(BUT_RIGHT) == LOW) {
+        log_i("Left and right held at boot, running the self-test");
+        SelfTest<OutputSample>{out, app.batteryAdc}.run();
+    }
+#if PCM_CAPTURE
+    const auto tap = tasks::find(TASK_LAYOUT, "capture");
+    capture.begin(tap->priority, tap->core, tap->stack);
+    capture.setPoint(static_cast<CaptureTap::Point>(PCM_CAPTURE));
+    capture.setNarrow(PCM_CAPTURE_NARROW);
+    app.processed.setTap(capture);
+#endif
+    const auto monitor = tasks::find(TASK_LAYOUT, "health");
+    app.health.begin(100, monitor->priority, monitor->core, monitor->stack);
+    console.add("eq", "eq <band> <off|lp|hp|peak|lowshelf|highshelf> <Hz> <Q> <dB> | eq on|off", tuneEqualizer);
+    console.add("limiter", "limiter <ceiling dBFS> [release ms]", tuneLimiter);
+    console.add("update", "update <ssid> <password> <url>", updateFirmware);
+    console.add("layout", "layout [on|off]", switchTaskLayout);
     bt.set_avrc_metadata_attribute_mask(META_FLAGS);
     bt.set_avrc_metadata_callback(metadataCallback);
-    bt.set_avrc_rn_volumechange([](int volume) { meta.volume = static_cast<uint8_t>(volume); });
-    bt.set_avrc_rn_play_pos_callback([](uint32_t pos) { meta.position = pos; });
-    bt.set_avrc_rn_playstatus_callback([](esp_avrc_playback_stat_t status) { meta.playing = status; });
+    bt.set_volume_control(&sinkVolume);
+    bt.set_avrc_rn_volumechange([](int volume) { app.setVolume(volume); });
+    bt.set_avrc_rn_play_pos_callback([](uint32_t pos) { app.meta.onPosition(pos); });
+    bt.set_avrc_rn_playstatus_callback([](esp_avrc_playback_stat_t status) { app.meta.onPlayStatus(status); });
     bt.set_on_connection_state_changed(connectionStateChangedCallback);
-    bt.set_mono_downmix(true);
+    bt.set_rssi_callback([](esp_bt_gap_cb_param_t::read_rssi_delta_param &rssi) {
+        app.linkMonitor.onRssi(rssi.rssi_delta);
+    });
+    bt.set_rssi_active(true);
+    sinkRingControl = mem::allocate<StaticRingbuffer_t>(1, mem::Placement::INTERNAL, "sink ring control");
+    sinkRingStorage = mem::allocate<uint8_t>(SINK_RING_BYTES, mem::Placement::LARGE, "sink ring buffer");
+    bt.set_i2s_ringbuffer_size(SINK_RING_BYTES);
+    bt.set_i2s_ringbuffer_prefetch_percent(app.linkMonitor.depth().prefetchPercent);
+#if APPLY_TASK_LAYOUT
+    // Places BtAppTask now and BtI2STask when a stream starts, tasks::report() shows both once connected
+    bt.set_task_core(tasks::find(TASK_LAYOUT, "BtI2STask")->core);
+#endif
     bt.start("ESP32 Speaker", true);
+    app.start();
+    if (taskLayout) tasks::apply(TASK_LAYOUT, stockPriorities);
+    mem::report();
 }
 
 
 void loop() {
-    measureBattery();
-
-    left.loop();
-    right.loop();
-    center.loop();
-
-    if (static auto last = millis(); millis() - last > 2000) {
-        last = millis();
-        log_i("Metadata:"
-              "\nBattery voltage: %.3f V"
-              "\nPlaying: %s"
-              "\nTitle: %s"
-              "\nArtist: %s"
-              "\nAlbum: %s"
-              "\nPlaytime: %lu"
-              "\nPosition: %lu"
-              "\nVolume: %d",
-              batteryVoltage,
-              meta.playing == ESP_AVRC_PLAYBACK_PLAYING ? "true" : "false",
-              meta.title.c_str(), meta.artist.c_str(), meta.album.c_str(),
-              meta.playtime, meta.position, meta.volume);
+    app.loop();
+    console.loop();
+#if PCM_CAPTURE
+    if (static auto last = Clock::millis(); Clock::millis() - last > Speaker::STATUS_MS) {
+        last = Clock::millis();
+        const auto captured = capture.stats();
+        log_i("Capture: %lu frames, %llu bytes, %lu blocks dropped", captured.frames, captured.bytes,
+              captured.dropped);
     }
+#endif
 }
 
 
-static void measureBattery() {
-    constexpr auto factor = 6.9f / (22.0f + 6.9f); // Voltage divider factor
-    constexpr auto N = 10000;
-    static uint32_t samples[N]{};
-    static uint32_t i = 0;
-    samples[i] = analogReadMilliVolts(BAT_VOLT);
-    if (++i == N) {
-        i = 0;
-        auto sum = 0.0f;
-        for (auto sample: samples) {
-            sum += static_cast<float>(sample);
-        }
-        batteryVoltage = sum / N / factor / 1000.0f;
+static bool tuneEqualizer(int argc, char **argv) {
+    static constexpr const char *TYPES[] = {"off", "lp", "hp", "peak", "lowshelf", "highshelf"};
+    auto &eq = app.chain.get<dsp::Equalizer>();
+    if (argc == 2 && (strcmp(argv[1], "on") == 0 || strcmp(argv[1], "off") == 0)) {
+        eq.setEnabled(argv[1][1] == 'n');
+        return true;
     }
-}
-
-static void metadataCallback(uint8_t id, const uint8_t *data) {
-    const auto string = reinterpret_cast<const char *>(data);
-    switch (id) {
-        case ESP_AVRC_MD_ATTR_TITLE:
-            meta.title = String(string);
-            break;
-        case ESP_AVRC_MD_ATTR_ARTIST:
-            meta.artist = String(string);
-            break;
-        case ESP_AVRC_MD_ATTR_ALBUM:
-            meta.album = String(string);
-            break;
-        case ESP_AVRC_MD_ATTR_PLAYING_TIME:
-            meta.playtime = strtol(string, nullptr, 10);
-            break;
-        default:
-            break;
+    if (argc != 6) return false;
+    const auto band = strtoul(argv[1], nullptr, 10);
+    dsp::Filter filter{};
+    while (filter.type <= dsp::Filter::HIGH_SHELF && strcmp(argv[2], TYPES[filter.type]) != 0) {
+        filter.type = static_cast<dsp::Filter::Type>(filter.type + 1);
+    }
+    if (band >= dsp::Equalizer<int32_t>::MAX_BANDS || filter.type > dsp::Filter::HIGH_SHELF) return false;
+    filter.frequency = strtof(argv[3], nullptr);
+    filter.q = strtof(argv[4], nullptr);
+    filter.gainDb = strtof(argv[5], nullptr);
+    if (!eq.setBand(band, filter)) {
+        log_w("EQ band %lu rejected: needs 0 < Hz < half the sample rate, Q > 0, at most %.0f dB and coefficients "
+              "the fixed-point filter can hold", band, dsp::Equalizer<int32_t>::MAX_GAIN_DB);
+        return false;
     }
+    log_i("EQ band %lu: %s %.0f Hz, Q %.2f, %.1f dB", band, argv[2], filter.frequency, filter.q, filter.gainDb);
+    return true;
 }
 
-static void connectionStateChangedCallback(esp_a2d_connection_state_t state, void *) {
-    switch (state) {
-        case ESP_A2D_CONNECTION_STATE_CONNECTED: {
-            log_i("A2DP connected");
-            // TODO: Play connected sound
-            break;
-        }
-        case ESP_A2D_CONNECTION_STATE_DISCONNECTED: {
-            log_w("A2DP disconnected");
-            // TODO: Play disconnected sound
-            break;
-        }
-        default:
-            break;
+static bool tuneLimiter(int argc, char **argv) {
+    if (argc < 2 || argc > 3) return false;
+    const auto ceiling = strtof(argv[1], nullptr);
+    if (ceiling > 0.0f) return false;
+    auto &limiter = app.chain.get<dsp::Limiter>();
+    limiter.setCeiling(std::pow(10.0f, ceiling / 20.0f));
+    log_i("Limiter ceiling %.1f dBFS", ceiling);
+    if (argc == 3) {
+        limiter.setRelease(strtof(argv[2], nullptr));
+        log_i("Limiter release %s ms", argv[2]);
     }
+    return true;
 }
 
-static void increaseVolume() {
-    log_i("Increase volume");
-    uint8_t volume = static_cast<uint8_t>(bt.get_volume()) + 4;
-    bt.set_volume(volume);
-    meta.volume = volume;
+static bool updateFirmware(int argc, char **argv) {
+    if (argc != 4) return false;
+    app.update(argv[1], argv[2], argv[3]);
+    return true;
 }
 
-static void nextTrack() {
-    log_i("Next track");
-    bt.next();
+/*
+ * Switches between the task layout's priorities and the stock ones while streaming and restarts the worst
+ * callback gap, so both can be compared on the same link. Cores stay as they were placed at startup.
+ */
+static bool switchTaskLayout(int argc, char **argv) {
+    if (argc == 2 && strcmp(argv[1], "on") == 0) {
+        taskLayout = true;
+        tasks::apply(TASK_LAYOUT, stockPriorities);
+    } else if (argc == 2 && strcmp(argv[1], "off") == 0) {
+        taskLayout = false;
+        tasks::restore(TASK_LAYOUT, stockPriorities);
+    } else if (argc != 1) {
+        return false;
+    }
+    if (argc == 2) app.processed.resetGap();
+    log_i("Task layout priorities %s, worst gap between blocks %lu us", taskLayout ? "on" : "off",
+          app.processed.getMetrics().maxGapMicros);
+    tasks::report(TASK_LAYOUT);
+    return true;
 }
 
-static void decreaseVolume() {
-    log_i("Decrease volume");
-    uint8_t volume = static_cast<uint8_t>(bt.get_volume()) - 4;
-    bt.set_volume(volume);
-    meta.volume = volume;
+static void metadataCallback(uint8_t id, const uint8_t *data) {
+    // The sink copies attr_text with a NUL after attr_length bytes but passes no length, payloadLength() finds it
+    app.meta.onAttribute(id, data, avrc::payloadLength(data, Metadata::MAX_PAYLOAD));
 }
 
-static void previousTrack() {
-    log_i("Previous track");
-    bt.previous();
+static void connectionStateChangedCallback(esp_a2d_connection_state_t state, void *) {
+    app.onConnectionState(state);
+    if (state != ESP_A2D_CONNECTION_STATE_CONNECTED) return;
+    if (taskLayout) tasks::apply(TASK_LAYOUT, stockPriorities);
+    tasks::report(TASK_LAYOUT);
 }
 
-static void changePlayState() {
-    log_i("Change play state");
-    switch (meta.playing) {
-        case ESP_AVRC_PLAYBACK_PAUSED:
-        case ESP_AVRC_PLAYBACK_STOPPED:
-            bt.play();
-            break;
-        case ESP_AVRC_PLAYBACK_PLAYING:
-            bt.pause();
-            break;
-        default:
-            break;
+/*
+ * The sink creates its jitter buffer with xRingbufferCreate() whenever a stream starts and offers no way to
+ * pass it memory. The firmware links with -Wl,--wrap=xRingbufferCreate, so that call lands here and gets the
+ * buffer allocated at boot through mem::, in PSRAM if the board has it. Other ring buffers, like the UART
+ * driver's, and a failed allocation fall through to the heap. The control block stays in internal RAM, its
+ * spinlock needs atomic access.
+ */
+extern "C" RingbufHandle_t __real_xRingbufferCreate(size_t size, RingbufferType_t type);
+
+extern "C" RingbufHandle_t __wrap_xRingbufferCreate(size_t size, RingbufferType_t type) {
+    if (type != RINGBUF_TYPE_BYTEBUF || size != SINK_RING_BYTES || !sinkRingControl || !sinkRingStorage) {
+        return __real_xRingbufferCreate(size, type);
     }
+    return xRingbufferCreateStatic(size, type, sinkRingStorage, sinkRingControl);
 }
 
-static void enterPairingMode() {
-    log_i("Enter pairing mode");
-    bt.disconnect();
+// Keeps an updated firmware pending until ota::confirm() instead of accepting it at boot
+extern "C" bool verifyRollbackLater() {
+    return true;
 }
@@ -0,0 +1,83 @@
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include "Metadata.hpp"
+
+/*
+ * libFuzzer target for the AVRC payload parsing, see the README for building and running it. The first input
+ * byte picks the attribute id and the text capacity, the rest is the payload. Every payload is copied into
+ * an allocation of exactly its length so the sanitizers catch reads past it; invariant violations trap.
+ */
+
+#define CHECK(condition) do { if (!(condition)) __builtin_trap(); } while (0)
+
+namespace {
+
+constexpr uint8_t IDS[] = {ESP_AVRC_MD_ATTR_TITLE, ESP_AVRC_MD_ATTR_ARTIST, ESP_AVRC_MD_ATTR_ALBUM,
+                           ESP_AVRC_MD_ATTR_TRACK_NUM, ESP_AVRC_MD_ATTR_NUM_TRACKS, ESP_AVRC_MD_ATTR_GENRE,
+                           ESP_AVRC_MD_ATTR_PLAYING_TIME, 0x00, 0x80, 0xFF};
+
+void checkText(const char *text, size_t capacity) {
+    const auto end = static_cast<const char *>(memchr(text, '\0', capacity));
+    CHECK(end != nullptr);
+    for (auto c = text; c < end; ++c) CHECK(static_cast<uint8_t>(*c) >= 0x20);
+}
+
+void checkCopy(const uint8_t *data, size_t length, size_t capacity) {
+    const auto dst = std::make_unique<char[]>(capacity ? capacity : 1);
+    const auto n = avrc::copyText(dst.get(), capacity, data, length);
+    if (capacity == 0) {
+        CHECK(n == 0);
+        return;
+    }
+    const auto available = avrc::payloadLength(data, length);
+    CHECK(n < capacity && n <= available && strlen(dst.get()) == n);
+    checkText(dst.get(), capacity);
+    // Truncation keeps whole UTF-8 characters: the first byte left out never continues a character, unless
+    // the payload itself starts in the middle of one
+    if (n > 0 && n < available) CHECK((data[n] & 0xC0) != 0x80);
+}
+
+void checkNumber(const uint8_t *data, size_t length) {
+    uint32_t value = 0xA5A5A5A5;
+    const auto parsed = avrc::parseUnsigned(data, length, value);
+    const auto n = avrc::payloadLength(data, length);
+    uint64_t expected = 0;
+    bool valid = n > 0;
+    for (size_t i = 0; i < n && valid; ++i) {
+        valid = data[i] >= '0' && data[i] <= '9';
+        expected = expected * 10 + (data[i] - '0');
+        valid = valid && expected <= UINT32_MAX;
+    }
+    CHECK(parsed == valid);
+    CHECK(parsed ? value == expected : value == 0xA5A5A5A5);
+}
+
+}
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *input, size_t size) {
+    if (size == 0) return 0;
+    const auto selector = input[0];
+    const auto length = size - 1;
+    const auto payload = std::make_unique<uint8_t[]>(length ? length : 1);
+    memcpy(payload.get(), input + 1, length);
+    const auto data = length ? payload.get() : nullptr;
+
+    const auto n = avrc::payloadLength(data, length);
+    CHECK(n <= length);
+    if (n < length) CHECK(data[n] == '\0');
+    checkCopy(data, length, selector);
+    checkNumber(data, length);
+
+    static Metadata meta{};
+    meta.onAttribute(IDS[selector % sizeof(IDS)], data, length);
+    checkText(meta.title, sizeof(meta.title));
+    checkText(meta.artist, sizeof(meta.artist));
+    checkText(meta.album, sizeof(meta.album));
+    meta.onPlayStatus(static_cast<esp_avrc_playback_stat_t>(selector));
+    CHECK(meta.playing <= ESP_AVRC_PLAYBACK_REV_SEEK || meta.playing == ESP_AVRC_PLAYBACK_ERROR);
+    meta.onVolume(static_cast<int8_t>(selector) * 3);
+    CHECK(meta.volume <= 0x7F);
+    return 0;
+}
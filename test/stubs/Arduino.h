@@ -0,0 +1,214 @@
+#ifndef ARDUINO_H
+#define ARDUINO_H
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdarg>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+/*
+ * Mock of the Arduino core and the FreeRTOS declarations the headers use, for host builds. Time is virtual:
+ * millis() and micros() only move when a test calls mock::advance() or the code under test delay(), and wrap
+ * like on the device. GPIO levels and ADC readings are set by the test, writes are recorded. Tasks are never
+ * created, task functions return the values of a task that does not exist. Restarts and deep sleep return
+ * and are recorded, Serial discards its output.
+ */
+
+#define HIGH 0x1
+#define LOW 0x0
+#define INPUT 0x01
+#define OUTPUT 0x03
+#define PULLUP 0x04
+#define INPUT_PULLUP 0x05
+
+typedef enum { ADC_0db, ADC_2_5db, ADC_6db, ADC_11db } adc_attenuation_t;
+
+typedef int esp_err_t;
+#define ESP_OK 0
+#define ESP_FAIL -1
+
+namespace mock {
+
+constexpr uint8_t PINS = 40;
+
+struct Pin {
+    uint8_t mode = INPUT;
+    uint8_t level = LOW;   /* Driven by the test for inputs, last written for outputs */
+    uint16_t adc = 0;      /* Raw reading returned by analogRead() */
+    uint32_t writes = 0;   /* Level changes written */
+    uint32_t changed = 0;  /* millis() of the last level change */
+};
+
+inline uint64_t elapsed = 0;  /* Virtual time in microseconds */
+inline Pin pins[PINS]{};
+inline uint32_t cpuMhz = 240;
+inline bool verbose = false;  /* Prints log_x output */
+inline uint32_t restarts = 0;     /* Calls of ESP.restart() */
+inline uint64_t deepSleepAt = 0;  /* Virtual time deep sleep was entered, 0 while awake */
+
+inline uint32_t millis() { return static_cast<uint32_t>(elapsed / 1000); }
+
+inline void advance(uint64_t micros) { elapsed += micros; }
+
+inline void advanceTo(uint64_t micros) { elapsed = std::max(elapsed, micros); }
+
+// Resets all pins and starts virtual time at micros, e.g. just before millis() wraps
+inline void reset(uint64_t micros = 0) {
+    elapsed = micros;
+    for (auto &pin: pins) pin = {};
+    cpuMhz = 240;
+    restarts = 0;
+    deepSleepAt = 0;
+}
+
+inline void setLevel(uint8_t pin, uint8_t level) {
+    if (pins[pin].level == level) return;
+    pins[pin].level = level;
+    pins[pin].changed = millis();
+}
+
+inline void setAdc(uint8_t pin, uint16_t raw) { pins[pin].adc = raw; }
+
+inline void log(char level, const char *format, ...) {
+    if (!verbose) return;
+    va_list args;
+    va_start(args, format);
+    printf("[%c][%10.3f] ", level, static_cast<double>(elapsed) / 1e6);
+    vprintf(format, args);
+    putchar('\n');
+    va_end(args);
+}
+
+}
+
+#define log_e(format, ...) mock::log('E', format, ##__VA_ARGS__)
+#define log_w(format, ...) mock::log('W', format, ##__VA_ARGS__)
+#define log_i(format, ...) mock::log('I', format, ##__VA_ARGS__)
+#define log_d(format, ...) mock::log('D', format, ##__VA_ARGS__)
+
+inline uint32_t millis() { return mock::millis(); }
+
+inline uint32_t micros() { return static_cast<uint32_t>(mock::elapsed); }
+
+inline void delay(uint32_t ms) { mock::advance(uint64_t{ms} * 1000); }
+
+inline void pinMode(uint8_t pin, uint8_t mode) {
+    mock::pins[pin].mode = mode;
+    if (mode == INPUT_PULLUP) mock::setLevel(pin, HIGH);
+}
+
+inline void digitalWrite(uint8_t pin, uint8_t value) {
+    if (mock::pins[pin].level != value) mock::pins[pin].writes++;
+    mock::setLevel(pin, value);
+}
+
+inline int digitalRead(uint8_t pin) { return mock::pins[pin].level; }
+
+inline uint16_t analogRead(uint8_t pin) { return mock::pins[pin].adc; }
+
+inline void analogReadResolution(uint8_t) {}
+
+inline void analogSetPinAttenuation(uint8_t, adc_attenuation_t) {}
+
+inline uint32_t getCpuFrequencyMhz() { return mock::cpuMhz; }
+
+inline bool setCpuFrequencyMhz(uint32_t mhz) {
+    mock::cpuMhz = mhz;
+    return true;
+}
+
+// Cycles of real time at the mocked CPU frequency, so processing costs are measured on the host
+struct EspClass {
+    uint32_t getCycleCount() {
+        using namespace std::chrono;
+        const auto ns = duration_cast<nanoseconds>(steady_clock::now().time_since_epoch()).count();
+        return static_cast<uint32_t>(static_cast<uint64_t>(ns) * mock::cpuMhz / 1000);
+    }
+
+    void restart() { mock::restarts++; }
+};
+
+inline EspClass ESP;
+
+class Print {
+public:
+    virtual ~Print() = default;
+
+    virtual size_t write(const uint8_t *data, size_t size) = 0;
+};
+
+class Stream : public Print {
+public:
+    virtual int available() = 0;
+
+    virtual int read() = 0;
+
+    // Returns what is available at once, the core waits up to the stream timeout for the rest
+    size_t readBytes(uint8_t *buffer, size_t length) {
+        size_t n = 0;
+        for (int c; n < length && (c = read()) >= 0;) buffer[n++] = static_cast<uint8_t>(c);
+        return n;
+    }
+};
+
+class HardwareSerial : public Stream {
+public:
+    size_t write(const uint8_t *, size_t size) override { return size; }
+
+    int available() override { return 0; }
+
+    int read() override { return -1; }
+
+    void flush() {}
+};
+
+inline HardwareSerial Serial;
+
+typedef void *TaskHandle_t;
+typedef unsigned int UBaseType_t;
+typedef int BaseType_t;
+typedef uint32_t TickType_t;
+typedef enum { eRunning, eReady, eBlocked, eSuspended, eDeleted, eInvalid } eTaskState;
+
+#define configMAX_PRIORITIES 25
+#define tskNO_AFFINITY 0x7FFFFFFF
+#define portMAX_DELAY 0xFFFFFFFF
+#define pdTRUE 1
+#define pdPASS 1
+#define pdFAIL 0
+#define pdMS_TO_TICKS(ms) (ms)
+
+inline BaseType_t xTaskCreatePinnedToCore(void (*)(void *), const char *, uint32_t, void *, UBaseType_t,
+                                          TaskHandle_t *task, BaseType_t) {
+    if (task) *task = nullptr;
+    return pdFAIL;
+}
+
+inline TaskHandle_t xTaskGetCurrentTaskHandle() { return nullptr; }
+
+inline TickType_t xTaskGetTickCount() { return millis(); }
+
+inline void vTaskDelayUntil(TickType_t *wake, TickType_t ticks) {
+    *wake += ticks;
+    mock::advanceTo(uint64_t{*wake} * 1000);
+}
+
+inline eTaskState eTaskGetState(TaskHandle_t) { return eInvalid; }
+
+inline const char *pcTaskGetTaskName(TaskHandle_t) { return "mock"; }
+
+inline UBaseType_t uxTaskPriorityGet(TaskHandle_t) { return 0; }
+
+inline UBaseType_t uxTaskGetStackHighWaterMark(TaskHandle_t) { return 0; }
+
+inline void xTaskNotifyGive(TaskHandle_t) {}
+
+inline uint32_t ulTaskNotifyTake(BaseType_t, TickType_t) { return 0; }
+
+
+#endif //ARDUINO_H
@@ -0,0 +1,42 @@
+#ifndef AUDIO_TOOLS_H
+#define AUDIO_TOOLS_H
+
+#include <Arduino.h>
+
+/*
+ * The part of arduino-audio-tools that PipelineStream derives from, for host builds.
+ */
+namespace audio_tools {
+
+struct AudioInfo {
+    int sample_rate = 44100;
+    int channels = 2;
+    int bits_per_sample = 16;
+};
+
+class AudioStream : public Stream {
+public:
+    virtual bool begin() { return true; }
+
+    virtual void end() {}
+
+    virtual void setAudioInfo(AudioInfo value) { info = value; }
+
+    virtual AudioInfo audioInfo() { return info; }
+
+    size_t write(const uint8_t *, size_t size) override { return size; }
+
+    virtual int availableForWrite() { return 1024; }
+
+    int available() override { return 0; }
+
+    int read() override { return -1; }
+
+protected:
+    AudioInfo info{};
+};
+
+}
+
+
+#endif //AUDIO_TOOLS_H
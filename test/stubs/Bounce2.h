@@ -0,0 +1,118 @@
+#ifndef BOUNCE2_H
+#define BOUNCE2_H
+
+#include <Arduino.h>
+
+/*
+ * Bounce2 2.72 for host builds, reduced to the default stable-interval debouncing Button uses: the debounced
+ * state follows the pin once it stayed unchanged for the interval. Time comes from the Arduino mock, times
+ * are 32 bits wide like unsigned long on the ESP32.
+ */
+class Debouncer {
+    static constexpr uint8_t DEBOUNCED_STATE = 0b001;
+    static constexpr uint8_t UNSTABLE_STATE = 0b010;
+    static constexpr uint8_t CHANGED_STATE = 0b100;
+public:
+    virtual ~Debouncer() = default;
+
+    void interval(uint16_t value) { interval_millis = value; }
+
+    bool update() {
+        unsetStateFlag(CHANGED_STATE);
+        const auto current = readCurrentState();
+        if (current != getStateFlag(UNSTABLE_STATE)) {
+            previous_millis = millis();
+            toggleStateFlag(UNSTABLE_STATE);
+        } else if (millis() - previous_millis >= interval_millis && current != getStateFlag(DEBOUNCED_STATE)) {
+            previous_millis = millis();
+            changeState();
+        }
+        return changed();
+    }
+
+    bool read() const { return getStateFlag(DEBOUNCED_STATE); }
+
+    bool fell() const { return !getStateFlag(DEBOUNCED_STATE) && getStateFlag(CHANGED_STATE); }
+
+    bool rose() const { return getStateFlag(DEBOUNCED_STATE) && getStateFlag(CHANGED_STATE); }
+
+    bool changed() const { return getStateFlag(CHANGED_STATE); }
+
+    uint32_t currentDuration() const { return millis() - stateChangeLastTime; }
+
+    uint32_t previousDuration() const { return durationOfPreviousState; }
+
+protected:
+    void begin() {
+        state = 0;
+        if (readCurrentState()) setStateFlag(DEBOUNCED_STATE | UNSTABLE_STATE);
+        previous_millis = millis();
+    }
+
+    virtual bool readCurrentState() = 0;
+
+    uint32_t previous_millis = 0;
+    uint16_t interval_millis = 10;
+    uint8_t state = 0;
+    uint32_t stateChangeLastTime = 0;
+    uint32_t durationOfPreviousState = 0;
+
+private:
+    void setStateFlag(uint8_t flag) { state |= flag; }
+
+    void unsetStateFlag(uint8_t flag) { state &= ~flag; }
+
+    void toggleStateFlag(uint8_t flag) { state ^= flag; }
+
+    bool getStateFlag(uint8_t flag) const { return (state & flag) != 0; }
+
+    void changeState() {
+        toggleStateFlag(DEBOUNCED_STATE);
+        setStateFlag(CHANGED_STATE);
+        durationOfPreviousState = millis() - stateChangeLastTime;
+        stateChangeLastTime = millis();
+    }
+};
+
+class Bounce : public Debouncer {
+public:
+    void attach(int pin) {
+        this->pin = pin;
+        begin();
+    }
+
+    void attach(int pin, int mode) {
+        pinMode(pin, mode);
+        attach(pin);
+    }
+
+    int getPin() const { return pin; }
+
+protected:
+    bool readCurrentState() override { return digitalRead(pin); }
+
+    uint8_t pin = 0;
+};
+
+namespace Bounce2 {
+
+class Button : public Bounce {
+public:
+    void setPressedState(bool state) { stateForPressed = state; }
+
+    bool getPressedState() const { return stateForPressed; }
+
+    bool isPressed() const { return read() == getPressedState(); }
+
+    bool pressed() const { return changed() && isPressed(); }
+
+    bool released() const { return changed() && !isPressed(); }
+
+protected:
+    bool stateForPressed = true;
+};
+
+}
+
+
+#endif //BOUNCE2_H
@@ -0,0 +1,104 @@
+#ifndef HTTP_CLIENT_H
+#define HTTP_CLIENT_H
+
+#include <Arduino.h>
+#include <string>
+#include <vector>
+
+/*
+ * Mock of the Arduino HTTP client for host builds, answering every GET from the scripted mock::http::server.
+ * The body arrives in segments of chunk bytes, one every segmentMicros of virtual time, so a reader that
+ * waits with delay() receives it at that rate. The server can stop sending while keeping the connection
+ * open, or close it, after a number of bytes.
+ */
+
+#define HTTP_CODE_OK 200
+#define HTTP_CODE_NOT_FOUND 404
+#define HTTPC_ERROR_CONNECTION_REFUSED (-1)
+
+namespace mock::http {
+
+struct Server {
+    int code = HTTP_CODE_OK;
+    std::vector<uint8_t> body;
+    bool chunked = false;          /* Sends no Content-Length, getSize() returns -1 */
+    size_t chunk = 1460;           /* Bytes per segment */
+    uint32_t segmentMicros = 1000;
+    size_t stallAt = SIZE_MAX;     /* Stops sending after these bytes and keeps the connection open */
+    size_t closeAt = SIZE_MAX;     /* Closes the connection after these bytes */
+    std::string url;               /* Of the last request */
+    uint32_t requests = 0;
+};
+
+inline Server server{};
+
+inline void reset() { server = {}; }
+
+}
+
+class WiFiClient : public Stream {
+public:
+    void open() {
+        sent = ready = 0;
+        next = mock::elapsed;
+    }
+
+    size_t write(const uint8_t *, size_t) override { return 0; }
+
+    int available() override {
+        arrive();
+        return static_cast<int>(ready - sent);
+    }
+
+    int read() override { return available() ? mock::http::server.body[sent++] : -1; }
+
+    bool connected() {
+        arrive();
+        return sent < ready || ready < std::min(mock::http::server.body.size(), mock::http::server.closeAt);
+    }
+
+private:
+    void arrive() {
+        const auto &server = mock::http::server;
+        const auto end = std::min({server.body.size(), server.stallAt, server.closeAt});
+        for (; ready < end && mock::elapsed >= next; next += server.segmentMicros) {
+            ready = std::min(ready + server.chunk, end);
+        }
+    }
+
+    size_t sent = 0;   /* Bytes read */
+    size_t ready = 0;  /* Bytes arrived */
+    uint64_t next = 0;
+};
+
+class HTTPClient {
+public:
+    void setTimeout(uint16_t) {}
+
+    bool begin(const char *url) {
+        if (strncmp(url, "http://", 7) != 0) return false;
+        mock::http::server.url = url;
+        return true;
+    }
+
+    int GET() {
+        mock::http::server.requests++;
+        if (mock::http::server.code == HTTP_CODE_OK) client.open();
+        return mock::http::server.code;
+    }
+
+    int getSize() {
+        return mock::http::server.chunked ? -1 : static_cast<int>(mock::http::server.body.size());
+    }
+
+    WiFiClient *getStreamPtr() { return &client; }
+
+    bool connected() { return client.connected(); }
+
+    void end() {}
+
+private:
+    WiFiClient client;
+};
+
+#endif //HTTP_CLIENT_H
@@ -0,0 +1,76 @@
+#ifndef PREFERENCES_H
+#define PREFERENCES_H
+
+#include <cstring>
+#include <map>
+#include <string>
+#include <vector>
+
+/*
+ * Mock of the Arduino NVS wrapper for host builds, keeping every namespace in memory for the process.
+ */
+class Preferences {
+public:
+    bool begin(const char *name, bool readOnly = false) {
+        space = &store()[name];
+        this->readOnly = readOnly;
+        return true;
+    }
+
+    void end() { space = nullptr; }
+
+    bool isKey(const char *key) { return space && space->count(key); }
+
+    float getFloat(const char *key, float value = 0.0f) {
+        get(key, &value, sizeof(value));
+        return value;
+    }
+
+    size_t putFloat(const char *key, float value) { return put(key, &value, sizeof(value)); }
+
+    uint8_t getUChar(const char *key, uint8_t value = 0) {
+        get(key, &value, sizeof(value));
+        return value;
+    }
+
+    size_t putUChar(const char *key, uint8_t value) { return put(key, &value, sizeof(value)); }
+
+    size_t getBytesLength(const char *key) { return isKey(key) ? (*space)[key].size() : 0; }
+
+    size_t getBytes(const char *key, void *buffer, size_t size) {
+        if (!isKey(key) || (*space)[key].size() > size) return 0;
+        return get(key, buffer, (*space)[key].size()) ? (*space)[key].size() : 0;
+    }
+
+    size_t putBytes(const char *key, const void *value, size_t size) { return put(key, value, size); }
+
+    // Drops every namespace, like erasing the NVS partition
+    static void erase() { store().clear(); }
+
+private:
+    using Space = std::map<std::string, std::vector<uint8_t>>;
+
+    static std::map<std::string, Space> &store() {
+        static std::map<std::string, Space> spaces;
+        return spaces;
+    }
+
+    bool get(const char *key, void *value, size_t size) {
+        if (!isKey(key) || (*space)[key].size() != size) return false;
+        memcpy(value, (*space)[key].data(), size);
+        return true;
+    }
+
+    size_t put(const char *key, const void *value, size_t size) {
+        if (!space || readOnly) return 0;
+        const auto bytes = static_cast<const uint8_t *>(value);
+        (*space)[key].assign(bytes, bytes + size);
+        return size;
+    }
+
+    Space *space = nullptr;
+    bool readOnly = false;
+};
+
+
+#endif //PREFERENCES_H
@@ -0,0 +1,78 @@
+#ifndef DRIVER_I2S_H
+#define DRIVER_I2S_H
+
+#include <Arduino.h>
+
+/*
+ * Mock of the legacy I2S driver's output side. i2s_write() queues the frames for playback at the mocked
+ * sample rate and, like the driver blocking on full DMA buffers, advances virtual time until no more than
+ * DMA_MICROS of audio is queued. Frames, their peak and clock stops are recorded.
+ */
+
+typedef enum { I2S_NUM_0 = 0, I2S_NUM_1 = 1, I2S_NUM_MAX } i2s_port_t;
+
+namespace mock::i2s {
+
+constexpr uint64_t DMA_MICROS = 8 * 256 * 1000000ull / 44100;  /* 8 descriptors of 256 frames */
+
+struct Port {
+    uint32_t sampleRate = 44100;
+    uint8_t bytesPerFrame = 8;    /* Stereo 32-bit slots */
+    bool running = true;
+    uint64_t queuedUntil = 0;     /* Virtual time the queued audio has played by */
+    uint64_t frames = 0;
+    uint64_t audibleFrames = 0;   /* Frames with a sample above the silence threshold */
+    int32_t peak = 0;             /* Largest sample magnitude written, scaled to 16 bits */
+    uint32_t stops = 0;
+};
+
+inline Port ports[I2S_NUM_MAX]{};
+
+inline void reset() {
+    for (auto &port: ports) port = {};
+}
+
+}
+
+inline esp_err_t i2s_write(i2s_port_t port, const void *data, size_t size, size_t *written, TickType_t) {
+    auto &p = mock::i2s::ports[port];
+    *written = size;
+    if (!p.running) return ESP_OK;
+    const auto frames = size / p.bytesPerFrame;
+    const auto samples = size / (p.bytesPerFrame / 2);
+    bool audible = false;
+    for (size_t i = 0; i < samples; ++i) {
+        int32_t sample;
+        if (p.bytesPerFrame == 4) {
+            sample = static_cast<const int16_t *>(data)[i];
+        } else {
+            sample = static_cast<const int32_t *>(data)[i] >> 16;
+        }
+        const auto magnitude = std::abs(sample);
+        p.peak = std::max(p.peak, magnitude);
+        audible |= magnitude > 8;
+    }
+    p.frames += frames;
+    if (audible) p.audibleFrames += frames;
+    p.queuedUntil = std::max(p.queuedUntil, mock::elapsed) + frames * 1000000ull / p.sampleRate;
+    if (p.queuedUntil > mock::elapsed + mock::i2s::DMA_MICROS) {
+        mock::advanceTo(p.queuedUntil - mock::i2s::DMA_MICROS);
+    }
+    return ESP_OK;
+}
+
+inline esp_err_t i2s_stop(i2s_port_t port) {
+    mock::i2s::ports[port].running = false;
+    mock::i2s::ports[port].stops++;
+    return ESP_OK;
+}
+
+inline esp_err_t i2s_start(i2s_port_t port) {
+    mock::i2s::ports[port].running = true;
+    return ESP_OK;
+}
+
+inline esp_err_t i2s_zero_dma_buffer(i2s_port_t) { return ESP_OK; }
+
+
+#endif //DRIVER_I2S_H
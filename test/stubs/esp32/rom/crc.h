@@ -0,0 +1,20 @@
+#ifndef ESP32_ROM_CRC_H
+#define ESP32_ROM_CRC_H
+
+#include <cstddef>
+#include <cstdint>
+
+/*
+ * The ROM's CRC-32 for host builds, same polynomial and conventions as crc32_le in the ESP32 ROM.
+ */
+inline uint32_t crc32_le(uint32_t crc, const uint8_t *data, uint32_t length) {
+    crc = ~crc;
+    for (uint32_t i = 0; i < length; ++i) {
+        crc ^= data[i];
+        for (int bit = 0; bit < 8; ++bit) crc = crc >> 1 ^ (0xEDB88320u & -(crc & 1));
+    }
+    return ~crc;
+}
+
+
+#endif //ESP32_ROM_CRC_H
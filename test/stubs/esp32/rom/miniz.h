@@ -0,0 +1,100 @@
+#ifndef ESP32_ROM_MINIZ_H
+#define ESP32_ROM_MINIZ_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <zlib.h>
+
+/*
+ * The ROM's tinfl inflater for host builds on top of zlib, linked with -lz. Same calling conventions as
+ * tinfl_decompress: input and output are consumed in whatever amounts fit, a wrapping output buffer has to be
+ * a power of two starting at the buffer, running out of input is an error without TINFL_FLAG_HAS_MORE_INPUT.
+ * zlib keeps its own dictionary where the ROM reads back-references from the wrapping buffer, so the mock fails
+ * a call that does not continue where the last one stopped or finds the last 32 KiB of output changed. zlib's
+ * allocations live inside the decompressor, so freeing it like the ROM's releases everything.
+ */
+
+typedef uint8_t mz_uint8;
+typedef uint32_t mz_uint32;
+
+#define TINFL_LZ_DICT_SIZE 32768
+#define TINFL_FLAG_PARSE_ZLIB_HEADER 1
+#define TINFL_FLAG_HAS_MORE_INPUT 2
+#define TINFL_FLAG_USING_NON_WRAPPING_OUTPUT_BUF 4
+
+typedef enum {
+    TINFL_STATUS_BAD_PARAM = -3,
+    TINFL_STATUS_ADLER32_MISMATCH = -2,
+    TINFL_STATUS_FAILED = -1,
+    TINFL_STATUS_DONE = 0,
+    TINFL_STATUS_NEEDS_MORE_INPUT = 1,
+    TINFL_STATUS_HAS_MORE_OUTPUT = 2,
+} tinfl_status;
+
+struct tinfl_decompressor {
+    z_stream stream;
+    bool started;
+    size_t used;
+    uint8_t history[TINFL_LZ_DICT_SIZE];   /* What the wrapping buffer has to hold */
+    alignas(16) uint8_t arena[64 * 1024];  /* zlib's state and its 32 KiB window */
+};
+
+inline void tinfl_init(tinfl_decompressor *r) {
+    r->started = false;
+    r->used = 0;
+}
+
+inline tinfl_status tinfl_decompress(tinfl_decompressor *r, const mz_uint8 *in, size_t *inSize,
+                                     mz_uint8 *outStart, mz_uint8 *outNext, size_t *outSize, mz_uint32 flags) {
+    const size_t mask = flags & TINFL_FLAG_USING_NON_WRAPPING_OUTPUT_BUF ? SIZE_MAX
+                                                                         : outNext - outStart + *outSize - 1;
+    if (((mask + 1) & mask) || outNext < outStart) {
+        *inSize = *outSize = 0;
+        return TINFL_STATUS_BAD_PARAM;
+    }
+    auto &stream = r->stream;
+    const auto offset = static_cast<size_t>(outNext - outStart);
+    const size_t total = r->started ? stream.total_out : 0;
+    const auto tracked = mask + 1 == TINFL_LZ_DICT_SIZE;
+    if (!(flags & TINFL_FLAG_USING_NON_WRAPPING_OUTPUT_BUF) &&
+        (offset != (total & mask) || (tracked && memcmp(outStart, r->history, std::min(total, mask + 1)) != 0))) {
+        *inSize = *outSize = 0;
+        return TINFL_STATUS_FAILED;
+    }
+    if (!r->started) {
+        memset(&stream, 0, sizeof(stream));
+        stream.opaque = r;
+        stream.zalloc = [](voidpf opaque, uInt items, uInt size) -> voidpf {
+            const auto self = static_cast<tinfl_decompressor *>(opaque);
+            const auto bytes = (size_t{items} * size + 15) & ~size_t{15};
+            if (self->used + bytes > sizeof(self->arena)) return Z_NULL;
+            self->used += bytes;
+            return self->arena + self->used - bytes;
+        };
+        stream.zfree = [](voidpf, voidpf) {};
+        if (inflateInit2(&stream, flags & TINFL_FLAG_PARSE_ZLIB_HEADER ? MAX_WBITS : -MAX_WBITS) != Z_OK) {
+            return TINFL_STATUS_FAILED;
+        }
+        r->started = true;
+    }
+    stream.next_in = const_cast<mz_uint8 *>(in);
+    stream.avail_in = static_cast<uInt>(*inSize);
+    stream.next_out = outNext;
+    stream.avail_out = static_cast<uInt>(*outSize);
+    const auto result = ::inflate(&stream, Z_NO_FLUSH);
+    *inSize -= stream.avail_in;
+    *outSize -= stream.avail_out;
+    if (tracked) memcpy(r->history + offset, outNext, *outSize);
+    if (result == Z_STREAM_END) return TINFL_STATUS_DONE;
+    if (result == Z_DATA_ERROR && stream.msg && strcmp(stream.msg, "incorrect data check") == 0) {
+        return TINFL_STATUS_ADLER32_MISMATCH;
+    }
+    if (result != Z_OK && result != Z_BUF_ERROR) return TINFL_STATUS_FAILED;
+    if (!stream.avail_out) return TINFL_STATUS_HAS_MORE_OUTPUT;
+    return flags & TINFL_FLAG_HAS_MORE_INPUT ? TINFL_STATUS_NEEDS_MORE_INPUT : TINFL_STATUS_FAILED;
+}
+
+
+#endif //ESP32_ROM_MINIZ_H
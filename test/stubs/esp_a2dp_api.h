@@ -0,0 +1,17 @@
+#ifndef ESP_A2DP_API_H
+#define ESP_A2DP_API_H
+
+#include "esp_bt_defs.h"
+
+/*
+ * The part of ESP-IDF's esp_a2dp_api.h that the App uses, with the same values, for host builds.
+ */
+
+typedef enum {
+    ESP_A2D_CONNECTION_STATE_DISCONNECTED = 0,
+    ESP_A2D_CONNECTION_STATE_CONNECTING,
+    ESP_A2D_CONNECTION_STATE_CONNECTED,
+    ESP_A2D_CONNECTION_STATE_DISCONNECTING,
+} esp_a2d_connection_state_t;
+
+#endif //ESP_A2DP_API_H
@@ -0,0 +1,27 @@
+#ifndef ESP_AVRC_API_H
+#define ESP_AVRC_API_H
+
+/*
+ * The part of ESP-IDF's esp_avrc_api.h that Metadata uses, with the same values, for host builds.
+ */
+
+typedef enum {
+    ESP_AVRC_MD_ATTR_TITLE = 0x1,
+    ESP_AVRC_MD_ATTR_ARTIST = 0x2,
+    ESP_AVRC_MD_ATTR_ALBUM = 0x4,
+    ESP_AVRC_MD_ATTR_TRACK_NUM = 0x8,
+    ESP_AVRC_MD_ATTR_NUM_TRACKS = 0x10,
+    ESP_AVRC_MD_ATTR_GENRE = 0x20,
+    ESP_AVRC_MD_ATTR_PLAYING_TIME = 0x40,
+} esp_avrc_md_attr_mask_t;
+
+typedef enum {
+    ESP_AVRC_PLAYBACK_STOPPED = 0,
+    ESP_AVRC_PLAYBACK_PLAYING = 1,
+    ESP_AVRC_PLAYBACK_PAUSED = 2,
+    ESP_AVRC_PLAYBACK_FWD_SEEK = 3,
+    ESP_AVRC_PLAYBACK_REV_SEEK = 4,
+    ESP_AVRC_PLAYBACK_ERROR = 0xFF,
+} esp_avrc_playback_stat_t;
+
+#endif //ESP_AVRC_API_H
@@ -0,0 +1,15 @@
+#ifndef ESP_BT_DEFS_H
+#define ESP_BT_DEFS_H
+
+#include <cstdint>
+
+/*
+ * The part of ESP-IDF's esp_bt_defs.h that PeerList and the App use, for host builds.
+ */
+
+typedef uint8_t esp_bd_addr_t[6];
+
+#define ESP_BD_ADDR_STR "%02x:%02x:%02x:%02x:%02x:%02x"
+#define ESP_BD_ADDR_HEX(addr) addr[0], addr[1], addr[2], addr[3], addr[4], addr[5]
+
+#endif //ESP_BT_DEFS_H
@@ -0,0 +1,16 @@
+#ifndef ESP_GAP_BT_API_H
+#define ESP_GAP_BT_API_H
+
+#include "esp_bt_defs.h"
+
+/*
+ * The part of ESP-IDF's esp_gap_bt_api.h that the App uses, with the same values, for host builds.
+ */
+
+typedef enum {
+    ESP_BT_NON_DISCOVERABLE,
+    ESP_BT_LIMITED_DISCOVERABLE,
+    ESP_BT_GENERAL_DISCOVERABLE,
+} esp_bt_discovery_mode_t;
+
+#endif //ESP_GAP_BT_API_H
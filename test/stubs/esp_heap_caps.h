@@ -0,0 +1,47 @@
+#ifndef ESP_HEAP_CAPS_H
+#define ESP_HEAP_CAPS_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+/*
+ * Mock of the capability-aware heap for host builds. Internal RAM is an arena of the ESP32's size that is
+ * never freed, like mem::allocate() on the device, and the board has no PSRAM.
+ */
+
+#define MALLOC_CAP_8BIT (1 << 2)
+#define MALLOC_CAP_DMA (1 << 3)
+#define MALLOC_CAP_SPIRAM (1 << 10)
+#define MALLOC_CAP_INTERNAL (1 << 11)
+
+namespace mock::heap {
+
+constexpr size_t SIZE = 320 * 1024;
+
+alignas(64) inline uint8_t arena[SIZE];
+inline size_t used = 0;
+
+}
+
+inline void *heap_caps_aligned_calloc(size_t alignment, size_t n, size_t size, uint32_t caps) {
+    using namespace mock::heap;
+    const auto start = (used + alignment - 1) / alignment * alignment;
+    if (caps & MALLOC_CAP_SPIRAM || start + n * size > SIZE) return nullptr;
+    used = start + n * size;
+    memset(arena + start, 0, n * size);
+    return arena + start;
+}
+
+inline size_t heap_caps_get_total_size(uint32_t caps) { return caps & MALLOC_CAP_SPIRAM ? 0 : mock::heap::SIZE; }
+
+inline size_t heap_caps_get_free_size(uint32_t caps) {
+    return heap_caps_get_total_size(caps) ? mock::heap::SIZE - mock::heap::used : 0;
+}
+
+inline size_t heap_caps_get_largest_free_block(uint32_t caps) { return heap_caps_get_free_size(caps); }
+
+inline size_t heap_caps_get_minimum_free_size(uint32_t caps) { return heap_caps_get_free_size(caps); }
+
+
+#endif //ESP_HEAP_CAPS_H
@@ -0,0 +1,111 @@
+#ifndef ESP_OTA_OPS_H
+#define ESP_OTA_OPS_H
+
+#include <Arduino.h>
+#include <esp_partition.h>
+#include <vector>
+
+/*
+ * Mock of the OTA API for host builds: two application slots of partitions.csv, the update slot's flash
+ * kept in memory. Writes are checked like the real ones, the first byte of an image has to be the
+ * application image magic 0xE9 and nothing may be written past the slot. Booting a new slot only records
+ * it, the state of the running slot is set by the test.
+ */
+
+typedef uint32_t esp_ota_handle_t;
+
+typedef enum {
+    ESP_OTA_IMG_NEW = 0,
+    ESP_OTA_IMG_PENDING_VERIFY = 1,
+    ESP_OTA_IMG_VALID = 2,
+    ESP_OTA_IMG_INVALID = 3,
+    ESP_OTA_IMG_ABORTED = 4,
+    ESP_OTA_IMG_UNDEFINED = -1,
+} esp_ota_img_states_t;
+
+#define ESP_ERR_INVALID_ARG 0x102
+#define ESP_ERR_INVALID_SIZE 0x104
+#define ESP_ERR_OTA_VALIDATE_FAILED 0x1503
+
+namespace mock::ota {
+
+constexpr uint8_t IMAGE_MAGIC = 0xE9;
+constexpr esp_partition_t SLOTS[2] = {{0x10000, 0x1E0000, "app0"}, {0x1F0000, 0x1E0000, "app1"}};
+
+inline esp_partition_t slots[2] = {SLOTS[0], SLOTS[1]};
+inline size_t running = 0;                              /* Index of the running slot */
+inline size_t boot = 0;                                 /* Index of the slot booted next */
+inline esp_ota_img_states_t state = ESP_OTA_IMG_VALID;  /* Of the running slot */
+inline std::vector<uint8_t> flash;                      /* Written to the update slot */
+inline esp_ota_handle_t handle = 0;                     /* Open update, 0 if none */
+inline uint32_t begins = 0;
+inline uint32_t aborts = 0;
+
+inline void reset() {
+    slots[0] = SLOTS[0];
+    slots[1] = SLOTS[1];
+    running = boot = 0;
+    state = ESP_OTA_IMG_VALID;
+    flash.clear();
+    handle = 0;
+    begins = aborts = 0;
+}
+
+}
+
+inline const esp_partition_t *esp_ota_get_running_partition() { return &mock::ota::slots[mock::ota::running]; }
+
+inline const esp_partition_t *esp_ota_get_next_update_partition(const esp_partition_t *) {
+    return &mock::ota::slots[1 - mock::ota::running];
+}
+
+inline esp_err_t esp_ota_begin(const esp_partition_t *partition, size_t size, esp_ota_handle_t *handle) {
+    if (partition == esp_ota_get_running_partition() || mock::ota::handle) return ESP_ERR_INVALID_ARG;
+    if (size > partition->size) return ESP_ERR_INVALID_SIZE;
+    mock::ota::flash.clear();
+    mock::ota::begins++;
+    *handle = mock::ota::handle = mock::ota::begins;
+    return ESP_OK;
+}
+
+inline esp_err_t esp_ota_write(esp_ota_handle_t handle, const void *data, size_t size) {
+    auto &flash = mock::ota::flash;
+    const auto bytes = static_cast<const uint8_t *>(data);
+    if (!handle || handle != mock::ota::handle) return ESP_ERR_INVALID_ARG;
+    if (flash.empty() && size > 0 && bytes[0] != mock::ota::IMAGE_MAGIC) return ESP_ERR_OTA_VALIDATE_FAILED;
+    if (flash.size() + size > mock::ota::slots[1 - mock::ota::running].size) return ESP_ERR_INVALID_SIZE;
+    flash.insert(flash.end(), bytes, bytes + size);
+    return ESP_OK;
+}
+
+inline esp_err_t esp_ota_end(esp_ota_handle_t handle) {
+    if (!handle || handle != mock::ota::handle) return ESP_ERR_INVALID_ARG;
+    mock::ota::handle = 0;
+    return mock::ota::flash.empty() ? ESP_ERR_OTA_VALIDATE_FAILED : ESP_OK;
+}
+
+inline esp_err_t esp_ota_abort(esp_ota_handle_t handle) {
+    if (!handle || handle != mock::ota::handle) return ESP_ERR_INVALID_ARG;
+    mock::ota::handle = 0;
+    mock::ota::aborts++;
+    return ESP_OK;
+}
+
+inline esp_err_t esp_ota_set_boot_partition(const esp_partition_t *partition) {
+    if (partition != &mock::ota::slots[0] && partition != &mock::ota::slots[1]) return ESP_ERR_INVALID_ARG;
+    mock::ota::boot = partition == &mock::ota::slots[0] ? 0 : 1;
+    return ESP_OK;
+}
+
+inline esp_err_t esp_ota_get_state_partition(const esp_partition_t *partition, esp_ota_img_states_t *state) {
+    if (partition != esp_ota_get_running_partition()) return ESP_ERR_INVALID_ARG;
+    *state = mock::ota::state;
+    return ESP_OK;
+}
+
+inline esp_err_t esp_ota_mark_app_valid_cancel_rollback() {
+    mock::ota::state = ESP_OTA_IMG_VALID;
+    return ESP_OK;
+}
+
+#endif //ESP_OTA_OPS_H
@@ -0,0 +1,16 @@
+#ifndef ESP_PARTITION_H
+#define ESP_PARTITION_H
+
+#include <cstdint>
+
+/*
+ * Mock of the partition descriptor for host builds, only the fields the headers read.
+ */
+
+typedef struct {
+    uint32_t address;
+    uint32_t size;
+    char label[17];
+} esp_partition_t;
+
+#endif //ESP_PARTITION_H
@@ -0,0 +1,20 @@
+#ifndef ESP_SLEEP_H
+#define ESP_SLEEP_H
+
+#include <Arduino.h>
+
+/*
+ * Mock of the sleep API for host builds. Deep sleep returns instead of resetting the chip and records when
+ * it was entered in mock::deepSleepAt, so tests can stop the device there.
+ */
+
+typedef enum {
+    ESP_SLEEP_WAKEUP_UNDEFINED,
+    ESP_SLEEP_WAKEUP_ALL,
+} esp_sleep_source_t;
+
+inline esp_err_t esp_sleep_disable_wakeup_source(esp_sleep_source_t) { return ESP_OK; }
+
+inline void esp_deep_sleep_start() { mock::deepSleepAt = mock::elapsed; }
+
+#endif //ESP_SLEEP_H
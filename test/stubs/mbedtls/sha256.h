@@ -0,0 +1,101 @@
+#ifndef MBEDTLS_SHA256_H
+#define MBEDTLS_SHA256_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+/*
+ * The SHA-256 of mbed TLS for host builds, a plain FIPS 180-4 implementation behind the same calls. SHA-224
+ * is not supported.
+ */
+
+typedef struct {
+    uint64_t total;  /* Bytes hashed */
+    uint32_t state[8];
+    uint8_t buffer[64];
+} mbedtls_sha256_context;
+
+namespace mock::sha256 {
+
+constexpr uint32_t K[64] = {
+        0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+        0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+        0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+        0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+        0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+        0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+        0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+        0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+};
+
+inline uint32_t rotate(uint32_t x, int n) { return x >> n | x << (32 - n); }
+
+inline void block(uint32_t *state, const uint8_t *data) {
+    uint32_t w[64];
+    for (int i = 0; i < 16; ++i) {
+        w[i] = uint32_t{data[4 * i]} << 24 | uint32_t{data[4 * i + 1]} << 16 | uint32_t{data[4 * i + 2]} << 8 |
+               data[4 * i + 3];
+    }
+    for (int i = 16; i < 64; ++i) {
+        const auto s0 = rotate(w[i - 15], 7) ^ rotate(w[i - 15], 18) ^ w[i - 15] >> 3;
+        const auto s1 = rotate(w[i - 2], 17) ^ rotate(w[i - 2], 19) ^ w[i - 2] >> 10;
+        w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+    }
+    uint32_t v[8];
+    memcpy(v, state, sizeof(v));
+    for (int i = 0; i < 64; ++i) {
+        const auto t1 = v[7] + (rotate(v[4], 6) ^ rotate(v[4], 11) ^ rotate(v[4], 25)) +
+                        ((v[4] & v[5]) ^ (~v[4] & v[6])) + K[i] + w[i];
+        const auto t2 = (rotate(v[0], 2) ^ rotate(v[0], 13) ^ rotate(v[0], 22)) +
+                        ((v[0] & v[1]) ^ (v[0] & v[2]) ^ (v[1] & v[2]));
+        memmove(v + 1, v, 7 * sizeof(uint32_t));
+        v[4] += t1;
+        v[0] = t1 + t2;
+    }
+    for (int i = 0; i < 8; ++i) state[i] += v[i];
+}
+
+}
+
+inline void mbedtls_sha256_init(mbedtls_sha256_context *ctx) { memset(ctx, 0, sizeof(*ctx)); }
+
+inline void mbedtls_sha256_free(mbedtls_sha256_context *ctx) { memset(ctx, 0, sizeof(*ctx)); }
+
+inline int mbedtls_sha256_starts(mbedtls_sha256_context *ctx, int is224) {
+    static constexpr uint32_t INITIAL[8] = {0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+                                            0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19};
+    if (is224) return -1;
+    ctx->total = 0;
+    memcpy(ctx->state, INITIAL, sizeof(INITIAL));
+    return 0;
+}
+
+inline int mbedtls_sha256_update(mbedtls_sha256_context *ctx, const uint8_t *input, size_t length) {
+    while (length) {
+        const auto used = ctx->total % 64;
+        const auto n = std::min<size_t>(length, 64 - used);
+        memcpy(ctx->buffer + used, input, n);
+        ctx->total += n;
+        input += n;
+        length -= n;
+        if (used + n == 64) mock::sha256::block(ctx->state, ctx->buffer);
+    }
+    return 0;
+}
+
+inline int mbedtls_sha256_finish(mbedtls_sha256_context *ctx, uint8_t output[32]) {
+    const auto bits = ctx->total * 8;
+    const uint8_t pad = 0x80;
+    static constexpr uint8_t ZEROS[64] = {};
+    mbedtls_sha256_update(ctx, &pad, 1);
+    mbedtls_sha256_update(ctx, ZEROS, (64 + 56 - ctx->total % 64) % 64);
+    uint8_t length[8];
+    for (int i = 0; i < 8; ++i) length[i] = static_cast<uint8_t>(bits >> (56 - 8 * i));
+    mbedtls_sha256_update(ctx, length, sizeof(length));
+    for (int i = 0; i < 32; ++i) output[i] = static_cast<uint8_t>(ctx->state[i / 4] >> (24 - 8 * (i % 4)));
+    return 0;
+}
+
+#endif //MBEDTLS_SHA256_H
@@ -0,0 +1,142 @@
+#include <unity.h>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include "AssetStore.hpp"
+#include "Oscillator.hpp"
+
+/*
+ * The host backend of AssetStore against test/data/assets.bin, packed by scripts/pack_assets.py from
+ * test/data/assets. After changing the packer or the fixtures, repack with
+ * python scripts/pack_assets.py test/data/assets test/data/assets.bin. Damaged copies of the blob check that
+ * begin() refuses anything it could hand out bad pointers for.
+ */
+
+#ifndef TEST_DATA_DIR
+#define TEST_DATA_DIR "test/data"
+#endif
+
+const std::string BLOB = std::string(TEST_DATA_DIR) + "/assets.bin";
+
+
+void setUp() {}
+
+void tearDown() {}
+
+static std::vector<uint8_t> readBlob() {
+    std::vector<uint8_t> bytes;
+    const auto f = fopen(BLOB.c_str(), "rb");
+    if (!f) return bytes;
+    uint8_t chunk[256];
+    size_t read;
+    while ((read = fread(chunk, 1, sizeof(chunk), f)) > 0) bytes.insert(bytes.end(), chunk, chunk + read);
+    fclose(f);
+    return bytes;
+}
+
+// Writes bytes to a temporary file and tries to map it
+static bool beginWith(const std::vector<uint8_t> &bytes) {
+    char path[] = "/tmp/assetsXXXXXX";
+    const auto fd = mkstemp(path);
+    TEST_ASSERT_TRUE(fd >= 0);
+    const auto written = write(fd, bytes.data(), bytes.size());
+    close(fd);
+    TEST_ASSERT_EQUAL(bytes.size(), static_cast<size_t>(written));
+    AssetStore store{};
+    const auto result = store.begin(path);
+    unlink(path);
+    return result;
+}
+
+static void test_finds_packed_assets() {
+    AssetStore store{};
+    TEST_ASSERT_TRUE_MESSAGE(store.begin(BLOB.c_str()), "Missing test/data/assets.bin, run scripts/pack_assets.py");
+    TEST_ASSERT_EQUAL(3, store.count());
+
+    const auto cue = store.find("cues/chime");
+    TEST_ASSERT_TRUE(cue);
+    TEST_ASSERT_EQUAL(3, cue.count<dsp::Tone>());
+    const auto tones = cue.as<dsp::Tone>();
+    TEST_ASSERT_EQUAL_UINT16(1000, tones[0].frequency);
+    TEST_ASSERT_EQUAL_UINT16(50, tones[0].millis);
+    TEST_ASSERT_EQUAL_UINT16(0, tones[1].frequency);
+    TEST_ASSERT_EQUAL_UINT16(1500, tones[2].frequency);
+    TEST_ASSERT_EQUAL_UINT16(80, tones[2].millis);
+
+    const auto text = store.find("hello.txt");
+    TEST_ASSERT_EQUAL(15, text.size);
+    TEST_ASSERT_EQUAL_MEMORY("Hello, speaker\n", text.data, text.size);
+
+    const auto ramp = store.find("tables/ramp.bin");
+    TEST_ASSERT_EQUAL(10, ramp.count<int32_t>());
+    for (int32_t i = 0; i < 10; ++i) TEST_ASSERT_EQUAL_INT32(i * 1000 - 4000, ramp.as<int32_t>()[i]);
+
+    // Every asset starts aligned within the blob, so as<T>() is safe on the mapping
+    for (size_t i = 0; i < store.count(); ++i) TEST_ASSERT_EQUAL(0, store[i].offset % AssetStore::ALIGNMENT);
+}
+
+static void test_missing_names() {
+    AssetStore store{};
+    TEST_ASSERT_TRUE(store.begin(BLOB.c_str()));
+    TEST_ASSERT_FALSE(store.find("cues/chime.tones"));
+    TEST_ASSERT_FALSE(store.find("cues"));
+    TEST_ASSERT_FALSE(store.find(""));
+    TEST_ASSERT_FALSE(store.find("zzz"));
+    store.end();
+    TEST_ASSERT_EQUAL(0, store.count());
+    TEST_ASSERT_FALSE(store.find("hello.txt"));
+    TEST_ASSERT_FALSE(store.begin(TEST_DATA_DIR "/no_such_blob.bin"));
+}
+
+static void test_rejects_damaged_blobs() {
+    const auto blob = readBlob();
+    TEST_ASSERT_TRUE(blob.size() > sizeof(AssetStore::Header) + 3 * sizeof(AssetStore::Entry));
+    TEST_ASSERT_TRUE(beginWith(blob));
+
+    auto damaged = blob;
+    damaged[0] ^= 0xFF;
+    TEST_ASSERT_FALSE_MESSAGE(beginWith(damaged), "bad magic");
+
+    damaged = blob;
+    damaged[4] = AssetStore::VERSION + 1;
+    TEST_ASSERT_FALSE_MESSAGE(beginWith(damaged), "unknown version");
+
+    damaged.assign(blob.begin(), blob.end() - AssetStore::ALIGNMENT);
+    TEST_ASSERT_FALSE_MESSAGE(beginWith(damaged), "truncated");
+
+    damaged.assign(blob.begin(), blob.begin() + 4);
+    TEST_ASSERT_FALSE_MESSAGE(beginWith(damaged), "shorter than the header");
+
+    // Swapping the first two index entries breaks the order the lookup relies on
+    damaged = blob;
+    const auto first = damaged.begin() + sizeof(AssetStore::Header);
+    std::swap_ranges(first, first + sizeof(AssetStore::Entry), first + sizeof(AssetStore::Entry));
+    TEST_ASSERT_FALSE_MESSAGE(beginWith(damaged), "unsorted index");
+
+    damaged = blob;
+    auto entry = reinterpret_cast<AssetStore::Entry *>(damaged.data() + sizeof(AssetStore::Header));
+    entry->size = static_cast<uint32_t>(blob.size());
+    TEST_ASSERT_FALSE_MESSAGE(beginWith(damaged), "asset past the end");
+
+    damaged = blob;
+    entry = reinterpret_cast<AssetStore::Entry *>(damaged.data() + sizeof(AssetStore::Header));
+    entry->offset += 1;
+    TEST_ASSERT_FALSE_MESSAGE(beginWith(damaged), "misaligned asset");
+
+    damaged = blob;
+    entry = reinterpret_cast<AssetStore::Entry *>(damaged.data() + sizeof(AssetStore::Header));
+    memset(entry->name, 'a', AssetStore::MAX_NAME);
+    TEST_ASSERT_FALSE_MESSAGE(beginWith(damaged), "unterminated name");
+}
+
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_finds_packed_assets);
+    RUN_TEST(test_missing_names);
+    RUN_TEST(test_rejects_damaged_blobs);
+    return UNITY_END();
+}
@@ -0,0 +1,58 @@
+#include <unity.h>
+#include "BenchmarkSuite.hpp"
+
+/*
+ * Host half of the benchmarks: runs every kernel of the benchmark firmware from BenchmarkSuite.hpp and prints
+ * the same JSON lines with the cost in ns per item. Run with pio test -e native -f test_benchmark -v to see
+ * the results, or pipe them into scripts/benchmark.py - to compare them against a host baseline. The tests
+ * check that every kernel the firmware reports ran once and produced a plausible timing.
+ */
+
+constexpr bench::Pins PINS{36, 6.9f / (22.0f + 6.9f), {26, 25, 27}};
+
+const char *const DSP_KERNELS[] = {
+        "convert_q15_q31", "downmix", "gain", "volume", "equalizer_5_bands", "limiter", "chain_fused",
+        "chain_staged", "convert_then_chain", "chain_widening", "block_copy_bytes", "path_separate_convert",
+        "path_widening", "dither_q31_q15", "cue_mix",
+};
+const char *const CONTROL_KERNELS[] = {
+        "metadata_title", "metadata_playtime", "battery_read", "governor_update", "button_poll",
+};
+
+
+void setUp() {
+    bench::clear();
+}
+
+void tearDown() {}
+
+template<size_t N>
+static void checkRecorded(const char *const (&names)[N]) {
+    TEST_ASSERT_EQUAL_MESSAGE(N, bench::count(), "Kernels added or dropped, update the lists above");
+    for (const auto name: names) {
+        const auto record = bench::find(name);
+        TEST_ASSERT_NOT_NULL_MESSAGE(record, name);
+        TEST_ASSERT_TRUE_MESSAGE(record->result.min > 0.0f, name);
+        TEST_ASSERT_TRUE_MESSAGE(record->result.min <= record->result.median, name);
+    }
+}
+
+static void test_dsp_kernels() {
+    bench::dspKernels();
+    checkRecorded(DSP_KERNELS);
+}
+
+static void test_control_kernels() {
+    mock::setAdc(PINS.battery, 2000);
+    bench::controlKernels(PINS);
+    checkRecorded(CONTROL_KERNELS);
+}
+
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_dsp_kernels);
+    RUN_TEST(test_control_kernels);
+    bench::done();
+    return UNITY_END();
+}
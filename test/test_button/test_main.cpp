@@ -0,0 +1,270 @@
+#include <unity.h>
+#include <cstdlib>
+#include <random>
+#include <vector>
+#include "Button.hpp"
+
+/*
+ * Property-based tests of Button's gesture timing. Each case generates a random sequence of short and long
+ * presses with contact bounce at both edges, glitches shorter than the debounce interval and random gaps,
+ * optionally starting just before millis() wraps, and plays it on the mocked pin. The button is polled like
+ * the firmware's loop, every few hundred microseconds with occasional stalls of up to MAX_STALL while the
+ * pin is stable; polling slower than the bounce would alias it. The actions Button runs must match a model
+ * of the gestures: exactly one action per press of the right kind, nothing for bounce and glitches, long
+ * presses while still held. Presses are kept MARGIN away from the thresholds, where the outcome
+ * legitimately depends on bounce and polling.
+ *
+ * A failing case prints its seed; BUTTON_SEED=<seed> pio test -e native -f test_button -v replays just that
+ * case and prints its sequence. BUTTON_CASES sets the number of cases.
+ */
+
+constexpr uint8_t PIN = 5;
+constexpr uint32_t LONG_PRESS = 330;     /* Button::LONG_PRESS_DURATION */
+constexpr uint32_t DOUBLE_WINDOW = 300;  /* Button::DOUBLE_PRESS_INTERVAL */
+constexpr uint32_t INTERVAL = 5;         /* Debounce interval Button defaults to */
+constexpr uint32_t MAX_BOUNCES = 5;
+constexpr uint32_t MAX_POLL_MICROS = 1000;  /* Longest regular loop period */
+constexpr uint32_t MAX_STALL = 40;          /* Longest loop stall, ms */
+// Bounce, debouncing and stalls shift the debounced edges and the long press by less than this
+constexpr uint32_t MARGIN = 2 * MAX_BOUNCES * (INTERVAL - 1) + INTERVAL + MAX_STALL + 10;
+constexpr uint32_t DEFAULT_CASES = 500;
+constexpr size_t PRESSES = 24;
+
+enum class Kind : uint8_t { SHORT, LONG };
+
+struct Press {
+    uint32_t gap;      /* From the previous release settling to this press starting, ms */
+    uint32_t held;     /* From the press settling to the release starting, ms */
+    Kind kind;
+    uint8_t bounces;   /* Contact bounces at each edge */
+    bool glitch;       /* Spike shorter than the debounce interval in the middle of the gap */
+};
+
+struct Case {
+    uint32_t seed;
+    uint64_t startMicros;
+    uint32_t maxPollMicros;
+    bool doublePress;
+    std::vector<Press> presses;
+};
+
+struct Actions {
+    uint32_t shorts = 0;
+    uint32_t longs = 0;
+    uint32_t doubles = 0;
+    uint32_t longsReleased = 0;  /* Long presses that ran after the button was released */
+};
+
+
+void setUp() {}
+
+void tearDown() {}
+
+static Case generate(uint32_t seed) {
+    std::mt19937 random{seed};
+    const auto uniform = [&random](uint32_t low, uint32_t high) {
+        return std::uniform_int_distribution<uint32_t>{low, high}(random);
+    };
+    Case result{seed, 0, uniform(200, MAX_POLL_MICROS), uniform(0, 1) == 1, {}};
+    // A third of the cases start within 5 s of millis() wrapping, the sequence then spans the wrap
+    const auto startMillis = uniform(0, 2) == 0 ? UINT32_MAX - uniform(0, 5000) : uniform(0, UINT32_MAX / 2);
+    result.startMicros = static_cast<uint64_t>(startMillis) * 1000;
+    for (size_t i = 0; i < PRESSES; ++i) {
+        Press press{};
+        press.kind = uniform(0, 2) == 0 ? Kind::LONG : Kind::SHORT;
+        press.held = press.kind == Kind::LONG ? uniform(LONG_PRESS + MARGIN, 2500) : uniform(30, LONG_PRESS - MARGIN);
+        press.bounces = static_cast<uint8_t>(uniform(0, MAX_BOUNCES));
+        // With double presses, a short press either follows the previous one well within the window or well after
+        const auto pair = result.doublePress && uniform(0, 1) == 1;
+        press.gap = pair ? uniform(30, DOUBLE_WINDOW - MARGIN) : uniform(DOUBLE_WINDOW + MARGIN, 1500);
+        press.glitch = !pair && uniform(0, 2) == 0;
+        result.presses.push_back(press);
+    }
+    return result;
+}
+
+// The actions the sequence must produce
+static Actions expect(const Case &c) {
+    Actions result{};
+    bool pending = false;
+    for (const auto &press: c.presses) {
+        const auto withinWindow = press.gap < DOUBLE_WINDOW;
+        if (pending && (press.kind == Kind::LONG || !withinWindow)) {
+            result.shorts++;
+            pending = false;
+        }
+        if (press.kind == Kind::LONG) {
+            result.longs++;
+        } else if (!c.doublePress) {
+            result.shorts++;
+        } else if (pending) {
+            result.doubles++;
+            pending = false;
+        } else {
+            pending = true;
+        }
+    }
+    if (pending) result.shorts++;
+    return result;
+}
+
+struct Change {
+    uint64_t micros;
+    uint8_t level;
+};
+
+// Level changes on the pin, bouncing edges toggle every 1 to INTERVAL - 1 ms before settling
+static std::vector<Change> waveform(const Case &c) {
+    std::mt19937 random{c.seed ^ 0x5A5A5A5Au};
+    const auto uniform = [&random](uint32_t low, uint32_t high) {
+        return std::uniform_int_distribution<uint32_t>{low, high}(random);
+    };
+    std::vector<Change> changes;
+    uint64_t time = c.startMicros + 100 * 1000;
+    const auto edge = [&](uint8_t level, uint8_t bounces) {
+        for (uint8_t i = 0; i < bounces; ++i) {
+            changes.push_back({time, level});
+            time += uniform(1, INTERVAL - 1) * 1000;
+            changes.push_back({time, static_cast<uint8_t>(!level)});
+            time += uniform(1, INTERVAL - 1) * 1000;
+        }
+        changes.push_back({time, level});
+    };
+    for (const auto &press: c.presses) {
+        if (press.glitch) {
+            const auto middle = time + press.gap / 2 * 1000;
+            changes.push_back({middle, LOW});
+            changes.push_back({middle + uniform(1, INTERVAL - 1) * 1000, HIGH});
+        }
+        time += press.gap * 1000;
+        edge(LOW, press.bounces);
+        time += press.held * 1000;
+        edge(HIGH, press.bounces);
+    }
+    changes.push_back({time + 2000 * 1000, HIGH});
+    return changes;
+}
+
+// Plays the case on the mocked pin, polling the button like the firmware's loop
+static Actions play(const Case &c, bool print) {
+    mock::reset(c.startMicros);
+    Actions actions{};
+    Button button{PIN, [&actions] { actions.shorts++; }, [&actions] {
+        actions.longs++;
+        if (digitalRead(PIN) == HIGH) actions.longsReleased++;
+    }};
+    if (c.doublePress) button.setDoublePress([&actions] { actions.doubles++; });
+    button.setup();
+    std::mt19937 random{c.seed};
+    const auto uniform = [&random](uint32_t low, uint32_t high) {
+        return std::uniform_int_distribution<uint32_t>{low, high}(random);
+    };
+    const auto changes = waveform(c);
+    size_t next = 0;
+    while (next < changes.size()) {
+        const uint64_t stall = uniform(0, 99) == 0 ? uniform(1, MAX_STALL) * 1000 : 0;
+        if (stall && changes[next].micros > mock::elapsed + stall + 10 * 1000) {
+            mock::advance(stall);
+        } else {
+            mock::advance(uniform(100, c.maxPollMicros));
+        }
+        for (; next < changes.size() && changes[next].micros <= mock::elapsed; ++next) {
+            mock::setLevel(PIN, changes[next].level);
+        }
+        button.loop();
+    }
+    if (print) {
+        printf("{\"seed\":%u,\"start_ms\":%u,\"poll_us\":%u,\"double\":%s}\n", c.seed,
+               static_cast<uint32_t>(c.startMicros / 1000), c.maxPollMicros, c.doublePress ? "true" : "false");
+        for (const auto &press: c.presses) {
+            printf("{\"gap\":%u,\"held\":%u,\"kind\":\"%s\",\"bounces\":%u,\"glitch\":%s}\n", press.gap,
+                   press.held, press.kind == Kind::LONG ? "long" : "short", press.bounces,
+                   press.glitch ? "true" : "false");
+        }
+    }
+    return actions;
+}
+
+static uint32_t cases() {
+    const auto value = getenv("BUTTON_CASES");
+    return value ? static_cast<uint32_t>(strtoul(value, nullptr, 10)) : DEFAULT_CASES;
+}
+
+static void check(const Case &c, bool print) {
+    const auto expected = expect(c);
+    const auto actual = play(c, print);
+    if (actual.shorts == expected.shorts && actual.longs == expected.longs && actual.doubles == expected.doubles &&
+        actual.longsReleased == 0) {
+        return;
+    }
+    char message[160];
+    snprintf(message, sizeof(message), "seed %u: %u short, %u long, %u double (%u after release), expected "
+             "%u, %u, %u", c.seed, actual.shorts, actual.longs, actual.doubles, actual.longsReleased,
+             expected.shorts, expected.longs, expected.doubles);
+    TEST_FAIL_MESSAGE(message);
+}
+
+static void test_one_action_per_press() {
+    if (const auto seed = getenv("BUTTON_SEED")) {
+        check(generate(static_cast<uint32_t>(strtoul(seed, nullptr, 10))), true);
+        return;
+    }
+    const auto n = cases();
+    for (uint32_t seed = 1; seed <= n; ++seed) check(generate(seed), false);
+}
+
+static void test_bounce_and_glitches_alone_do_nothing() {
+    mock::reset(static_cast<uint64_t>(UINT32_MAX - 200) * 1000);
+    Actions actions{};
+    Button button{PIN, [&actions] { actions.shorts++; }, [&actions] { actions.longs++; }};
+    button.setup();
+    std::mt19937 random{71};
+    // Spikes of up to INTERVAL - 1 ms low, each followed by at least the interval high, across the wrap
+    for (int i = 0; i < 2000; ++i) {
+        const auto low = std::uniform_int_distribution<uint32_t>{1, INTERVAL - 1}(random);
+        const auto high = std::uniform_int_distribution<uint32_t>{INTERVAL, 40}(random);
+        mock::setLevel(PIN, LOW);
+        for (uint32_t t = 0; t < low; ++t) {
+            button.loop();
+            mock::advance(1000);
+        }
+        mock::setLevel(PIN, HIGH);
+        for (uint32_t t = 0; t < high; ++t) {
+            button.loop();
+            mock::advance(1000);
+        }
+    }
+    TEST_ASSERT_TRUE(millis() < 1000000);
+    TEST_ASSERT_EQUAL_UINT32(0, actions.shorts);
+    TEST_ASSERT_EQUAL_UINT32(0, actions.longs);
+}
+
+static void test_press_spanning_the_wrap() {
+    for (const uint32_t held: {100u, 400u}) {
+        mock::reset(static_cast<uint64_t>(UINT32_MAX - 50) * 1000);
+        Actions actions{};
+        Button button{PIN, [&actions] { actions.shorts++; }, [&actions] { actions.longs++; }};
+        button.setup();
+        mock::setLevel(PIN, LOW);
+        for (uint32_t t = 0; t < held; ++t) {
+            button.loop();
+            mock::advance(1000);
+        }
+        mock::setLevel(PIN, HIGH);
+        for (int t = 0; t < 500; ++t) {
+            button.loop();
+            mock::advance(1000);
+        }
+        TEST_ASSERT_EQUAL_UINT32(held < LONG_PRESS, actions.shorts);
+        TEST_ASSERT_EQUAL_UINT32(held > LONG_PRESS, actions.longs);
+    }
+}
+
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_one_action_per_press);
+    RUN_TEST(test_bounce_and_glitches_alone_do_nothing);
+    RUN_TEST(test_press_spanning_the_wrap);
+    return UNITY_END();
+}
@@ -0,0 +1,206 @@
+#include <unity.h>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include "AudioChain.hpp"
+#include "Benchmark.hpp"
+
+/*
+ * Runs the WAV fixtures from scripts/make_fixtures.py through AudioChain the way PipelineStream does on the
+ * device, in blocks of BLOCK frames, and compares the output bit for bit against the goldens under
+ * test/data/golden. Any change to the chain's output fails here; when the change is intended, regenerate the
+ * goldens with UPDATE_GOLDEN=1 pio test -e native -f test_golden and review them like code.
+ *
+ * The processing cost is checked against NS_PER_SAMPLE_BUDGET, which fails the run rather than warning.
+ */
+
+#ifndef TEST_DATA_DIR
+#define TEST_DATA_DIR "test/data"
+#endif
+
+#ifndef NS_PER_SAMPLE_BUDGET
+#define NS_PER_SAMPLE_BUDGET 150.0f
+#endif
+
+constexpr size_t BLOCK = 256;
+constexpr uint32_t RATE = 44100;
+const char *const FIXTURES[] = {"sweep", "noise", "bursts"};
+
+struct Wav {
+    uint16_t bits = 0;
+    std::vector<uint8_t> data;  /* Interleaved stereo samples */
+};
+
+
+void setUp() {}
+
+void tearDown() {}
+
+static std::string path(const char *directory, const std::string &name) {
+    return std::string(TEST_DATA_DIR) + "/" + directory + "/" + name + ".wav";
+}
+
+static uint32_t le(const uint8_t *bytes, size_t size) {
+    uint32_t value = 0;
+    for (size_t i = 0; i < size; ++i) value |= static_cast<uint32_t>(bytes[i]) << (8 * i);
+    return value;
+}
+
+// Reads a stereo PCM WAV file, skipping chunks other than fmt and data
+static bool readWav(const std::string &file, Wav &wav) {
+    const auto f = fopen(file.c_str(), "rb");
+    if (!f) return false;
+    std::vector<uint8_t> bytes;
+    uint8_t chunk[4096];
+    size_t read;
+    while ((read = fread(chunk, 1, sizeof(chunk), f)) > 0) bytes.insert(bytes.end(), chunk, chunk + read);
+    fclose(f);
+    if (bytes.size() < 12 || memcmp(bytes.data(), "RIFF", 4) != 0 || memcmp(bytes.data() + 8, "WAVE", 4) != 0) {
+        return false;
+    }
+    bool format = false;
+    for (size_t offset = 12; offset + 8 <= bytes.size();) {
+        const auto size = le(&bytes[offset + 4], 4);
+        const auto body = &bytes[offset + 8];
+        if (size > bytes.size() - offset - 8) return false;
+        if (memcmp(&bytes[offset], "fmt ", 4) == 0 && size >= 16) {
+            format = le(body, 2) == 1 && le(body + 2, 2) == 2 && le(body + 4, 4) == RATE;
+            wav.bits = static_cast<uint16_t>(le(body + 14, 2));
+        } else if (memcmp(&bytes[offset], "data", 4) == 0) {
+            wav.data.assign(body, body + size);
+        }
+        offset += 8 + size + (size & 1);
+    }
+    return format && (wav.bits == 16 || wav.bits == 32);
+}
+
+static bool writeWav(const std::string &file, const Wav &wav) {
+    const auto f = fopen(file.c_str(), "wb");
+    if (!f) return false;
+    const uint32_t size = wav.data.size();
+    const uint16_t align = 2 * wav.bits / 8;
+    const uint32_t rate = RATE, byteRate = RATE * align, fmtSize = 16, riffSize = 36 + size;
+    const uint16_t pcm = 1, channels = 2;
+    fwrite("RIFF", 1, 4, f);
+    fwrite(&riffSize, 4, 1, f);
+    fwrite("WAVEfmt ", 1, 8, f);
+    fwrite(&fmtSize, 4, 1, f);
+    fwrite(&pcm, 2, 1, f);
+    fwrite(&channels, 2, 1, f);
+    fwrite(&rate, 4, 1, f);
+    fwrite(&byteRate, 4, 1, f);
+    fwrite(&align, 2, 1, f);
+    fwrite(&wav.bits, 2, 1, f);
+    fwrite("data", 1, 4, f);
+    fwrite(&size, 4, 1, f);
+    fwrite(wav.data.data(), 1, size, f);
+    return fclose(f) == 0;
+}
+
+// The stock configuration the firmware boots with
+static void configureDefault(AudioChain &chain) {
+    configureChain(chain, static_cast<float>(RATE));
+}
+
+// A tuned configuration exercising every stage, like a user equalizer preset at reduced volume
+static void configureTuned(AudioChain &chain) {
+    configureChain(chain, static_cast<float>(RATE));
+    auto &eq = chain.get<dsp::Equalizer>();
+    TEST_ASSERT_TRUE(eq.setBand(0, {dsp::Filter::LOW_SHELF, 120.0f, 0.707f, 6.0f}));
+    TEST_ASSERT_TRUE(eq.setBand(1, {dsp::Filter::PEAKING, 1000.0f, 1.4f, -4.0f}));
+    TEST_ASSERT_TRUE(eq.setBand(2, {dsp::Filter::HIGH_SHELF, 8000.0f, 0.707f, 9.0f}));
+    chain.get<dsp::Volume>().setVolume(110);
+    chain.get<dsp::Gain>().setGain(1.5f);
+    chain.get<dsp::Limiter>().setCeiling(0.8f);
+    chain.reset();
+}
+
+// Processes a fixture block by block, dithering down to 16 bits like AUDIO_OUTPUT_BITS=16 builds if bits is 16
+static Wav render(const Wav &input, void (*configure)(AudioChain &), uint16_t bits) {
+    AudioChain chain{};
+    configure(chain);
+    dsp::Dither dither{};
+    Wav output{bits, {}};
+    const auto samples = reinterpret_cast<const int16_t *>(input.data.data());
+    const auto frames = input.data.size() / 4;
+    int32_t block[BLOCK * 2];
+    int16_t narrowed[BLOCK * 2];
+    for (size_t start = 0; start < frames; start += BLOCK) {
+        const auto count = std::min(BLOCK, frames - start);
+        chain.process(samples + 2 * start, block, count);
+        const uint8_t *bytes = reinterpret_cast<const uint8_t *>(block);
+        auto size = count * 2 * sizeof(int32_t);
+        if (bits == 16) {
+            dither.process(block, narrowed, count);
+            bytes = reinterpret_cast<const uint8_t *>(narrowed);
+            size = count * 2 * sizeof(int16_t);
+        }
+        output.data.insert(output.data.end(), bytes, bytes + size);
+    }
+    return output;
+}
+
+static void check(const char *config, void (*configure)(AudioChain &), uint16_t bits) {
+    for (const auto fixture: FIXTURES) {
+        Wav input;
+        TEST_ASSERT_TRUE_MESSAGE(readWav(path("fixtures", fixture), input) && input.bits == 16,
+                                 "Missing fixture, run scripts/make_fixtures.py");
+        const auto output = render(input, configure, bits);
+        const auto name = std::string(fixture) + "_" + config;
+        const auto golden = path("golden", name);
+        if (getenv("UPDATE_GOLDEN")) {
+            TEST_ASSERT_TRUE_MESSAGE(writeWav(golden, output), golden.c_str());
+            printf("Updated %s\n", golden.c_str());
+            continue;
+        }
+        Wav expected;
+        TEST_ASSERT_TRUE_MESSAGE(readWav(golden, expected), ("Missing golden " + golden).c_str());
+        TEST_ASSERT_EQUAL_MESSAGE(bits, expected.bits, name.c_str());
+        TEST_ASSERT_EQUAL_MESSAGE(expected.data.size(), output.data.size(), name.c_str());
+        const auto frameBytes = 2u * bits / 8u;
+        for (size_t i = 0; i < output.data.size(); i += frameBytes) {
+            if (memcmp(&output.data[i], &expected.data[i], frameBytes) != 0) {
+                char message[128];
+                snprintf(message, sizeof(message), "%s differs from frame %zu", name.c_str(), i / frameBytes);
+                TEST_FAIL_MESSAGE(message);
+            }
+        }
+    }
+}
+
+static void test_default_matches_golden() {
+    check("default", configureDefault, 32);
+}
+
+static void test_tuned_matches_golden() {
+    check("tuned", configureTuned, 32);
+}
+
+static void test_tuned_dithered_matches_golden() {
+    check("tuned16", configureTuned, 16);
+}
+
+static void test_cost_within_budget() {
+    Wav input;
+    TEST_ASSERT_TRUE(readWav(path("fixtures", "noise"), input));
+    static AudioChain chain{};
+    configureTuned(chain);
+    static int32_t block[BLOCK * 2];
+    const auto samples = reinterpret_cast<const int16_t *>(input.data.data());
+    const auto result = bench::run("golden_chain", BLOCK * 2, [samples] { chain.process(samples, block, BLOCK); });
+    char message[96];
+    snprintf(message, sizeof(message), "%.1f ns/sample, budget %.1f", result.min, NS_PER_SAMPLE_BUDGET);
+    TEST_ASSERT_TRUE_MESSAGE(result.min <= NS_PER_SAMPLE_BUDGET, message);
+}
+
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_default_matches_golden);
+    RUN_TEST(test_tuned_matches_golden);
+    RUN_TEST(test_tuned_dithered_matches_golden);
+    RUN_TEST(test_cost_within_budget);
+    return UNITY_END();
+}
@@ -0,0 +1,75 @@
+#include <unity.h>
+#include <cstring>
+#include "Metadata.hpp"
+
+/*
+ * Edge cases of the AVRC payload parsing, including inputs found while fuzzing with test/fuzz.
+ */
+
+void setUp() {}
+
+void tearDown() {}
+
+static const uint8_t *bytes(const char *text) { return reinterpret_cast<const uint8_t *>(text); }
+
+static void test_payload_without_terminator() {
+    const uint8_t data[] = {'a', 'b', 'c'};
+    TEST_ASSERT_EQUAL(3, avrc::payloadLength(data, sizeof(data)));
+    TEST_ASSERT_EQUAL(1, avrc::payloadLength(bytes("a\0bc"), 4));
+    TEST_ASSERT_EQUAL(0, avrc::payloadLength(nullptr, 16));
+}
+
+static void test_copy_truncates_on_character_boundary() {
+    char dst[5];
+    // "aé€" is 1 + 2 + 3 bytes, the euro sign does not fit and is dropped as a whole
+    TEST_ASSERT_EQUAL(3, avrc::copyText(dst, sizeof(dst), bytes("a\xC3\xA9\xE2\x82\xAC"), 6));
+    TEST_ASSERT_EQUAL_STRING("a\xC3\xA9", dst);
+    TEST_ASSERT_EQUAL(0, avrc::copyText(dst, 2, bytes("\x80\x80"), 2));
+    TEST_ASSERT_EQUAL_STRING("", dst);
+    TEST_ASSERT_EQUAL(0, avrc::copyText(dst, 0, bytes("abc"), 3));
+}
+
+static void test_copy_replaces_control_characters() {
+    char dst[8];
+    TEST_ASSERT_EQUAL(3, avrc::copyText(dst, sizeof(dst), bytes("a\nb"), 3));
+    TEST_ASSERT_EQUAL_STRING("a b", dst);
+}
+
+static void test_parse_rejects_overflow_and_garbage() {
+    uint32_t value = 7;
+    TEST_ASSERT_TRUE(avrc::parseUnsigned(bytes("4294967295"), 10, value));
+    TEST_ASSERT_EQUAL_UINT32(UINT32_MAX, value);
+    TEST_ASSERT_FALSE(avrc::parseUnsigned(bytes("4294967296"), 10, value));
+    TEST_ASSERT_FALSE(avrc::parseUnsigned(bytes("12a"), 3, value));
+    TEST_ASSERT_FALSE(avrc::parseUnsigned(bytes("-1"), 2, value));
+    TEST_ASSERT_FALSE(avrc::parseUnsigned(bytes(""), 1, value));
+    TEST_ASSERT_EQUAL_UINT32(UINT32_MAX, value);
+}
+
+static void test_metadata_attributes() {
+    Metadata meta{};
+    const uint8_t title[] = {'S', 'o', 'n', 'g'};
+    meta.onAttribute(ESP_AVRC_MD_ATTR_TITLE, title, sizeof(title));
+    TEST_ASSERT_EQUAL_STRING("Song", meta.title);
+    meta.onAttribute(ESP_AVRC_MD_ATTR_PLAYING_TIME, bytes("180000"), 6);
+    TEST_ASSERT_EQUAL_UINT32(180000, meta.playtime);
+    meta.onAttribute(ESP_AVRC_MD_ATTR_PLAYING_TIME, bytes("n/a"), 3);
+    TEST_ASSERT_EQUAL_UINT32(0, meta.playtime);
+    meta.onAttribute(ESP_AVRC_MD_ATTR_GENRE, bytes("Jazz"), 4);
+    TEST_ASSERT_EQUAL_STRING("Unknown", meta.artist);
+    meta.onPlayStatus(static_cast<esp_avrc_playback_stat_t>(0x42));
+    TEST_ASSERT_EQUAL(ESP_AVRC_PLAYBACK_ERROR, meta.playing);
+    meta.onVolume(300);
+    TEST_ASSERT_EQUAL(0x7F, meta.volume);
+}
+
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_payload_without_terminator);
+    RUN_TEST(test_copy_truncates_on_character_boundary);
+    RUN_TEST(test_copy_replaces_control_characters);
+    RUN_TEST(test_parse_rejects_overflow_and_garbage);
+    RUN_TEST(test_metadata_attributes);
+    return UNITY_END();
+}
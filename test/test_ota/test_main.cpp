@@ -0,0 +1,181 @@
+#include <unity.h>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include "OtaUpdater.hpp"
+
+/*
+ * ota::pull() and ota::Updater against the scripted server of the HTTPClient mock, the OTA mock's flash and
+ * the zlib backed tinfl mock. test/data/ota/firmware.bin is 96 KiB starting with the image magic, random runs
+ * between long repeats, so the 32 KiB window wraps and short input inflates to more than fits; its image is
+ * packed by python scripts/ota_image.py test/data/ota/firmware.bin, repack it after changing the format.
+ */
+
+#ifndef TEST_DATA_DIR
+#define TEST_DATA_DIR "test/data"
+#endif
+
+constexpr char URL[] = "http://192.168.1.2:8000/";
+constexpr size_t SHA_OFFSET = 12;  /* Of the digest in the packed header */
+
+static std::vector<uint8_t> firmware;
+static std::vector<uint8_t> image;
+
+
+static std::vector<uint8_t> readFile(const std::string &name) {
+    std::vector<uint8_t> bytes;
+    const auto f = fopen((std::string(TEST_DATA_DIR) + "/ota/" + name).c_str(), "rb");
+    if (!f) return bytes;
+    uint8_t chunk[4096];
+    size_t read;
+    while ((read = fread(chunk, 1, sizeof(chunk), f)) > 0) bytes.insert(bytes.end(), chunk, chunk + read);
+    fclose(f);
+    return bytes;
+}
+
+void setUp() {
+    mock::reset();
+    mock::ota::reset();
+    mock::http::reset();
+    mock::http::server.body = image;
+}
+
+void tearDown() {}
+
+// Nothing was installed and no update is left open
+static void checkUntouched() {
+    TEST_ASSERT_EQUAL(0, mock::ota::boot);
+    TEST_ASSERT_EQUAL(0, mock::ota::handle);
+}
+
+static void test_installs_image() {
+    TEST_ASSERT_TRUE_MESSAGE(firmware.size() > TINFL_LZ_DICT_SIZE && image.size() > sizeof(ota::Updater::Header),
+                             "Missing test/data/ota/firmware.bin.ota, run scripts/ota_image.py");
+    ota::Updater updater{};
+    TEST_ASSERT_TRUE(ota::pull(updater, URL));
+    TEST_ASSERT_EQUAL(1, mock::http::server.requests);
+    TEST_ASSERT_EQUAL_STRING(URL, mock::http::server.url.c_str());
+    TEST_ASSERT_EQUAL(firmware.size(), mock::ota::flash.size());
+    TEST_ASSERT_EQUAL_MEMORY(firmware.data(), mock::ota::flash.data(), firmware.size());
+    TEST_ASSERT_EQUAL(1, mock::ota::boot);
+    TEST_ASSERT_EQUAL(0, mock::ota::handle);
+    TEST_ASSERT_EQUAL(0, mock::ota::aborts);
+    TEST_ASSERT_EQUAL(image.size(), updater.getStats().received);
+    TEST_ASSERT_EQUAL(firmware.size(), updater.getStats().written);
+}
+
+// Every split of the stream inflates the same, down to single bytes and without a Content-Length
+static void test_installs_image_in_any_chunks() {
+    for (const size_t chunk: {1, 7, 100, 1024, 5000}) {
+        for (const auto chunked: {false, true}) {
+            setUp();
+            mock::http::server.chunk = chunk;
+            mock::http::server.chunked = chunked;
+            ota::Updater updater{};
+            TEST_ASSERT_TRUE(ota::pull(updater, URL));
+            TEST_ASSERT_EQUAL(firmware.size(), mock::ota::flash.size());
+            TEST_ASSERT_EQUAL_MEMORY(firmware.data(), mock::ota::flash.data(), firmware.size());
+            TEST_ASSERT_EQUAL(1, mock::ota::boot);
+        }
+    }
+}
+
+static void test_rejects_truncated_download() {
+    // The connection drops halfway
+    mock::http::server.closeAt = image.size() / 2;
+    ota::Updater updater{};
+    TEST_ASSERT_FALSE(ota::pull(updater, URL));
+    TEST_ASSERT_EQUAL(ota::Updater::Error::SIZE, updater.getError());
+    TEST_ASSERT_EQUAL(1, mock::ota::aborts);
+    checkUntouched();
+
+    // The server holds a cut image and announces its length
+    setUp();
+    mock::http::server.body.resize(image.size() - 100);
+    TEST_ASSERT_FALSE(ota::pull(updater, URL));
+    TEST_ASSERT_EQUAL(ota::Updater::Error::SIZE, updater.getError());
+    checkUntouched();
+}
+
+static void test_rejects_corrupt_stream() {
+    mock::http::server.body[sizeof(ota::Updater::Header) + 200] ^= 0x55;
+    ota::Updater updater{};
+    TEST_ASSERT_FALSE(ota::pull(updater, URL));
+    TEST_ASSERT_EQUAL(ota::Updater::Error::INFLATE, updater.getError());
+    TEST_ASSERT_EQUAL(1, mock::ota::aborts);
+    checkUntouched();
+
+    // Bytes past the end of the zlib stream
+    setUp();
+    mock::http::server.body.insert(mock::http::server.body.end(), 16, 0);
+    TEST_ASSERT_FALSE(ota::pull(updater, URL));
+    TEST_ASSERT_EQUAL(ota::Updater::Error::INFLATE, updater.getError());
+    checkUntouched();
+}
+
+static void test_rejects_digest_mismatch() {
+    mock::http::server.body[SHA_OFFSET + 31] ^= 0x01;
+    ota::Updater updater{};
+    TEST_ASSERT_FALSE(ota::pull(updater, URL));
+    TEST_ASSERT_EQUAL(ota::Updater::Error::DIGEST, updater.getError());
+    // The whole image was written before the check, the slot is left unbootable
+    TEST_ASSERT_EQUAL(firmware.size(), mock::ota::flash.size());
+    TEST_ASSERT_EQUAL(1, mock::ota::aborts);
+    checkUntouched();
+}
+
+static void test_rejects_oversize_image() {
+    mock::ota::slots[1].size = static_cast<uint32_t>(firmware.size() - 1);
+    ota::Updater updater{};
+    TEST_ASSERT_FALSE(ota::pull(updater, URL));
+    TEST_ASSERT_EQUAL(ota::Updater::Error::HEADER, updater.getError());
+    // Refused on the header, before the slot was erased
+    TEST_ASSERT_EQUAL(0, mock::ota::begins);
+    checkUntouched();
+}
+
+static void test_gives_up_on_stalled_download() {
+    mock::http::server.chunk = 512;
+    mock::http::server.stallAt = image.size() / 2;
+    ota::Updater updater{};
+    TEST_ASSERT_FALSE(ota::pull(updater, URL));
+    const auto stalledAt = (image.size() / 2 + 511) / 512 - 1;  /* Segment the last bytes arrived in, in ms */
+    TEST_ASSERT_UINT32_WITHIN(2, stalledAt + ota::PULL_TIMEOUT_MS, millis());
+    TEST_ASSERT_EQUAL(1, mock::ota::aborts);
+    checkUntouched();
+}
+
+static void test_rejects_http_error() {
+    mock::http::server.code = HTTP_CODE_NOT_FOUND;
+    ota::Updater updater{};
+    TEST_ASSERT_FALSE(ota::pull(updater, URL));
+    TEST_ASSERT_EQUAL(0, mock::ota::begins);
+    checkUntouched();
+    TEST_ASSERT_FALSE(ota::pull(updater, "ftp://192.168.1.2/"));
+    TEST_ASSERT_EQUAL(1, mock::http::server.requests);
+}
+
+static void test_confirms_image_once_it_ran() {
+    mock::ota::state = ESP_OTA_IMG_PENDING_VERIFY;
+    ota::confirm(29999, 30000);
+    TEST_ASSERT_EQUAL(ESP_OTA_IMG_PENDING_VERIFY, mock::ota::state);
+    ota::confirm(30000, 30000);
+    TEST_ASSERT_EQUAL(ESP_OTA_IMG_VALID, mock::ota::state);
+}
+
+
+int main() {
+    firmware = readFile("firmware.bin");
+    image = readFile("firmware.bin.ota");
+    UNITY_BEGIN();
+    RUN_TEST(test_installs_image);
+    RUN_TEST(test_installs_image_in_any_chunks);
+    RUN_TEST(test_rejects_truncated_download);
+    RUN_TEST(test_rejects_corrupt_stream);
+    RUN_TEST(test_rejects_digest_mismatch);
+    RUN_TEST(test_rejects_oversize_image);
+    RUN_TEST(test_gives_up_on_stalled_download);
+    RUN_TEST(test_rejects_http_error);
+    RUN_TEST(test_confirms_image_once_it_ran);
+    return UNITY_END();
+}
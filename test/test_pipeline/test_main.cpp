@@ -0,0 +1,335 @@
+#include <unity.h>
+#include <cmath>
+#include <cstring>
+#include <random>
+#include <vector>
+#include "AudioChain.hpp"
+
+/*
+ * Fixed-point behaviour of the DSP stages: coefficient range, headroom in front of the equalizer, fused
+ * against per-stage processing, parameter changes taking effect at block boundaries and the equalizer's
+ * crossfade between coefficient banks.
+ */
+
+constexpr float RATE = 44100.0f;
+constexpr size_t FRAMES = 256;
+constexpr float Q31 = 2147483648.0f;
+constexpr dsp::Filter SHELF{dsp::Filter::HIGH_SHELF, 4000.0f, 0.707f, 12.0f};
+constexpr dsp::Filter CUT{dsp::Filter::PEAKING, 1000.0f, 1.0f, -12.0f};
+constexpr dsp::Filter BOOST{dsp::Filter::PEAKING, 1000.0f, 1.0f, 12.0f};
+constexpr size_t CROSSFADE = 256;  /* Frames over which the equalizer moves to changed bands */
+constexpr size_t BLOCK = 64;       /* A quarter of the crossfade, so band changes land in the middle of one */
+
+template<typename T>
+using Shelf = dsp::Pipeline<T, dsp::Equalizer>;
+template<typename T>
+using Boosted = dsp::Pipeline<T, dsp::Headroom, dsp::Equalizer>;
+
+
+void setUp() {}
+
+void tearDown() {}
+
+// Runs silence through the chain so the crossfade to newly set bands has finished
+template<typename Chain>
+static void settle(Chain &chain) {
+    typename Chain::sample_type silence[FRAMES * 2]{};
+    chain.process(silence, FRAMES);
+}
+
+static void fillSine(int32_t *q, float *f, float frequency, float level) {
+    for (size_t i = 0; i < FRAMES; ++i) {
+        const auto value = level * std::sin(2.0f * static_cast<float>(M_PI) * frequency * static_cast<float>(i) / RATE);
+        q[2 * i] = q[2 * i + 1] = static_cast<int32_t>(std::lrint(value * Q31));
+        f[2 * i] = f[2 * i + 1] = static_cast<float>(q[2 * i]) / Q31;
+    }
+}
+
+// Frames [start, start + count) of a 1 kHz sine, where the CUT and BOOST bands act
+static void fillTone(size_t start, size_t count, int32_t *q, float *f) {
+    for (size_t i = 0; i < count; ++i) {
+        const auto phase = 2.0f * static_cast<float>(M_PI) * 1000.0f * static_cast<float>(start + i) / RATE;
+        q[2 * i] = q[2 * i + 1] = static_cast<int32_t>(std::lrint(0.05f * std::sin(phase) * Q31));
+        f[2 * i] = f[2 * i + 1] = static_cast<float>(q[2 * i]) / Q31;
+    }
+}
+
+// Double precision model of a band change: both cascades run from the same history and mix linearly
+class Crossfade {
+public:
+    explicit Crossfade(const dsp::Filter &filter) { from.c = dsp::BiquadCoeffs::design(filter, RATE); }
+
+    void change(const dsp::Filter &filter) {
+        to = from;
+        to.c = dsp::BiquadCoeffs::design(filter, RATE);
+        frame = 0;
+        fading = true;
+    }
+
+    double operator()(double x) {
+        if (!fading) return from.run(x);
+        const auto weight = static_cast<double>(++frame) / CROSSFADE;
+        const auto y = (1.0 - weight) * from.run(x) + weight * to.run(x);
+        if (frame < CROSSFADE) return y;
+        from = to;
+        fading = false;
+        return y;
+    }
+
+private:
+    struct Biquad {
+        dsp::BiquadCoeffs c;
+        double x1 = 0.0, x2 = 0.0, y1 = 0.0, y2 = 0.0;
+
+        double run(double x) {
+            const auto y = c.b0 * x + c.b1 * x1 + c.b2 * x2 - c.a1 * y1 - c.a2 * y2;
+            x2 = x1;
+            x1 = x;
+            y2 = y1;
+            y1 = y;
+            return y;
+        }
+    };
+
+    Biquad from{}, to{};
+    size_t frame = 0;
+    bool fading = false;
+};
+
+static void test_shelf_boost_matches_float() {
+    Shelf<int32_t> fixed{};
+    Shelf<float> reference{};
+    TEST_ASSERT_TRUE(fixed.get<dsp::Equalizer>().setBand(0, SHELF));
+    TEST_ASSERT_TRUE(reference.get<dsp::Equalizer>().setBand(0, SHELF));
+    settle(fixed);
+    settle(reference);
+    int32_t q[FRAMES * 2]{};
+    float f[FRAMES * 2]{};
+    q[0] = q[1] = static_cast<int32_t>(0.125f * Q31);
+    f[0] = f[1] = 0.125f;
+    fixed.process(q, FRAMES);
+    reference.process(f, FRAMES);
+    for (size_t i = 0; i < FRAMES * 2; ++i) TEST_ASSERT_FLOAT_WITHIN(1e-6f, f[i], static_cast<float>(q[i]) / Q31);
+}
+
+static void test_rejects_bands_that_do_not_fit() {
+    using Eq = dsp::Equalizer<int32_t>;
+    TEST_ASSERT_TRUE(Eq::fits(SHELF, RATE));
+    TEST_ASSERT_FALSE(Eq::fits({dsp::Filter::HIGH_SHELF, 4000.0f, 0.707f, 18.0f}, RATE));
+    TEST_ASSERT_FALSE(Eq::fits({dsp::Filter::PEAKING, 30000.0f, 1.0f, 3.0f}, RATE));
+    TEST_ASSERT_FALSE(Eq::fits({dsp::Filter::PEAKING, 1000.0f, 0.0f, 3.0f}, RATE));
+    TEST_ASSERT_FALSE(Eq::fits({dsp::Filter::PEAKING, NAN, 1.0f, 3.0f}, RATE));
+    // Degenerates to a broadband boost with coefficients summing past what the accumulator can take
+    const dsp::Filter edge{dsp::Filter::HIGH_SHELF, 20.0f, 10.0f, 12.0f};
+    TEST_ASSERT_FALSE(Eq::fits(edge, RATE));
+    TEST_ASSERT_TRUE(dsp::Equalizer<float>::fits(edge, RATE));
+
+    Eq eq{};
+    TEST_ASSERT_TRUE(eq.setBand(1, SHELF));
+    TEST_ASSERT_FALSE(eq.setBand(1, edge));
+    TEST_ASSERT_FALSE(eq.setBand(Eq::MAX_BANDS, SHELF));
+    TEST_ASSERT_EQUAL(dsp::Filter::HIGH_SHELF, eq.getBand(1).type);
+    TEST_ASSERT_EQUAL_FLOAT(4000.0f, eq.getBand(1).frequency);
+}
+
+static void test_headroom_absorbs_full_scale_boost() {
+    Boosted<int32_t> fixed{};
+    Boosted<float> reference{};
+    TEST_ASSERT_TRUE(fixed.get<dsp::Equalizer>().setBand(0, SHELF));
+    TEST_ASSERT_TRUE(reference.get<dsp::Equalizer>().setBand(0, SHELF));
+    settle(fixed);
+    settle(reference);
+    int32_t q[FRAMES * 2];
+    float f[FRAMES * 2];
+    for (int block = 0; block < 4; ++block) {
+        fillSine(q, f, 8000.0f, 0.9f);
+        fixed.process(q, FRAMES);
+        reference.process(f, FRAMES);
+    }
+    float peak = 0.0f;
+    for (size_t i = 0; i < FRAMES * 2; ++i) {
+        TEST_ASSERT_FLOAT_WITHIN(1e-6f, f[i], static_cast<float>(q[i]) / Q31);
+        peak = std::max(peak, std::fabs(f[i]));
+    }
+    // Above full scale once the headroom is removed again, so it would have clipped without it
+    TEST_ASSERT_GREATER_THAN_FLOAT(0.25f, peak);
+}
+
+static void test_chain_limits_boost_to_ceiling() {
+    AudioChain chain{};
+    configureChain(chain, RATE);
+    TEST_ASSERT_TRUE(chain.get<dsp::Equalizer>().setBand(0, SHELF));
+    chain.get<dsp::Limiter>().setCeiling(0.5f);
+    settle(chain);
+    int32_t q[FRAMES * 2];
+    float f[FRAMES * 2];
+    float peak = 0.0f;
+    for (int block = 0; block < 8; ++block) {
+        fillSine(q, f, 8000.0f, 1.0f);
+        chain.process(q, FRAMES);
+        for (const auto sample: q) peak = std::max(peak, std::fabs(static_cast<float>(sample) / Q31));
+    }
+    TEST_ASSERT_LESS_OR_EQUAL_FLOAT(0.5f, peak);
+    TEST_ASSERT_GREATER_THAN_FLOAT(0.49f, peak);
+}
+
+static void test_default_chain_is_transparent() {
+    AudioChain chain{};
+    configureChain(chain, RATE);
+    std::mt19937 random{1};
+    int16_t input[FRAMES * 2];
+    int32_t output[FRAMES * 2];
+    for (size_t i = 0; i < FRAMES; ++i) {
+        input[2 * i] = input[2 * i + 1] = static_cast<int16_t>(random());
+    }
+    dsp::convert(input, output, FRAMES * 2);
+    chain.process(output, FRAMES);
+    for (size_t i = 0; i < FRAMES * 2; ++i) TEST_ASSERT_EQUAL_INT32(input[i] * 65536, output[i]);
+}
+
+static void test_fused_matches_chained() {
+    AudioChain fused{}, chained{};
+    for (auto chain: {&fused, &chained}) {
+        configureChain(*chain, RATE);
+        chain->get<dsp::Equalizer>().setBand(0, {dsp::Filter::LOW_SHELF, 120.0f, 0.707f, 6.0f});
+        chain->get<dsp::Equalizer>().setBand(1, SHELF);
+        chain->get<dsp::Volume>().setVolume(100);
+        chain->get<dsp::Limiter>().setCeiling(0.7f);
+    }
+    std::mt19937 random{2};
+    int32_t a[FRAMES * 2], b[FRAMES * 2];
+    for (int block = 0; block < 16; ++block) {
+        for (auto &sample: a) sample = static_cast<int32_t>(random());
+        memcpy(b, a, sizeof(a));
+        fused.process(a, FRAMES);
+        chained.processChained(b, FRAMES);
+        TEST_ASSERT_EQUAL_MEMORY(a, b, sizeof(a));
+    }
+}
+
+static void test_widening_pass_matches_separate_conversion() {
+    AudioChain fused{}, separate{};
+    for (auto chain: {&fused, &separate}) {
+        configureChain(*chain, RATE);
+        chain->get<dsp::Equalizer>().setBand(0, SHELF);
+        chain->get<dsp::Volume>().setVolume(90);
+    }
+    std::mt19937 random{3};
+    int16_t input[FRAMES * 2];
+    int32_t a[FRAMES * 2], b[FRAMES * 2];
+    for (int block = 0; block < 16; ++block) {
+        for (auto &sample: input) sample = static_cast<int16_t>(random());
+        fused.process(input, a, FRAMES);
+        dsp::convert(input, b, FRAMES * 2);
+        separate.process(b, FRAMES);
+        TEST_ASSERT_EQUAL_MEMORY(a, b, sizeof(a));
+    }
+}
+
+static void test_changes_apply_at_the_next_block() {
+    dsp::Pipeline<int32_t, dsp::Gain, dsp::Fade> chain{};
+    int32_t block[FRAMES * 2];
+    std::fill(block, block + FRAMES * 2, 1 << 20);
+    chain.get<dsp::Gain>().setGain(0.5f);
+    chain.get<dsp::Fade>().fadeTo(0.0f, 1000.0f * FRAMES / RATE);
+    chain.process(block, FRAMES);
+    // The whole block sees the new gain, the fade starts at its first frame and ends with the block
+    TEST_ASSERT_INT32_WITHIN((1 << 19) / FRAMES, 1 << 19, block[0]);
+    TEST_ASSERT_EQUAL_INT32(0, block[FRAMES * 2 - 1]);
+    for (size_t i = 2; i < FRAMES * 2; i += 2) TEST_ASSERT_TRUE(block[i] <= block[i - 2]);
+
+    // Re-enabling the equalizer clears its history before the block, like a freshly configured one
+    Shelf<int32_t> eq{}, fresh{};
+    for (auto chain: {&eq, &fresh}) {
+        chain->setSampleRate(RATE);
+        TEST_ASSERT_TRUE(chain->get<dsp::Equalizer>().setBand(0, SHELF));
+        settle(*chain);
+    }
+    int32_t a[FRAMES * 2], b[FRAMES * 2];
+    std::mt19937 random{4};
+    for (auto &sample: a) sample = static_cast<int32_t>(random()) >> 4;
+    eq.process(a, FRAMES);
+    eq.get<dsp::Equalizer>().setEnabled(false);
+    eq.process(a, FRAMES);
+    eq.get<dsp::Equalizer>().setEnabled(true);
+    for (auto &sample: a) sample = static_cast<int32_t>(random()) >> 4;
+    memcpy(b, a, sizeof(a));
+    eq.process(a, FRAMES);
+    fresh.process(b, FRAMES);
+    TEST_ASSERT_EQUAL_MEMORY(b, a, sizeof(a));
+}
+
+static void test_band_change_crossfades_continuously() {
+    Shelf<int32_t> fixed{};
+    TEST_ASSERT_TRUE(fixed.get<dsp::Equalizer>().setBand(0, CUT));
+    settle(fixed);
+    Crossfade reference{CUT};
+    constexpr size_t BLOCKS = 16, CHANGE = 6;
+    std::vector<float> q, f;
+    for (size_t block = 0; block < BLOCKS; ++block) {
+        if (block == CHANGE) {
+            TEST_ASSERT_TRUE(fixed.get<dsp::Equalizer>().setBand(0, BOOST));
+            reference.change(BOOST);
+        }
+        int32_t qb[BLOCK * 2];
+        float fb[BLOCK * 2];
+        fillTone(block * BLOCK, BLOCK, qb, fb);
+        fixed.process(qb, BLOCK);
+        for (size_t i = 0; i < BLOCK; ++i) {
+            q.push_back(static_cast<float>(qb[2 * i]) / Q31);
+            f.push_back(static_cast<float>(reference(fb[2 * i])));
+        }
+    }
+    for (size_t n = 1; n < q.size(); ++n) {
+        TEST_ASSERT_FLOAT_WITHIN(1e-5f, f[n], q[n]);
+        TEST_ASSERT_TRUE(std::fabs(q[n] - q[n - 1]) <= std::fabs(f[n] - f[n - 1]) + 1e-5f);
+    }
+}
+
+static void test_updates_during_crossfade_keep_busy_banks() {
+    Shelf<int32_t> eq{}, twin{};
+    for (auto chain: {&eq, &twin}) {
+        chain->setSampleRate(RATE);
+        TEST_ASSERT_TRUE(chain->get<dsp::Equalizer>().setBand(0, CUT));
+        settle(*chain);
+        TEST_ASSERT_TRUE(chain->get<dsp::Equalizer>().setBand(0, BOOST));
+    }
+    std::mt19937 random{5};
+    int32_t a[BLOCK * 2], b[BLOCK * 2];
+    const auto compare = [&] {
+        for (auto &sample: a) sample = static_cast<int32_t>(random()) >> 4;
+        memcpy(b, a, sizeof(a));
+        eq.process(a, BLOCK);
+        twin.process(b, BLOCK);
+        TEST_ASSERT_EQUAL_MEMORY(b, a, sizeof(a));
+    };
+    compare();
+
+    // More updates than banks while the crossfade reads two of them, each republishes into the spare ones
+    dsp::Filter last{};
+    for (int i = 0; i < 6; ++i) {
+        last = {dsp::Filter::PEAKING, 500.0f + 400.0f * static_cast<float>(i), 1.0f, 2.0f * static_cast<float>(i)};
+        TEST_ASSERT_TRUE(eq.get<dsp::Equalizer>().setBand(0, last));
+    }
+    // The running crossfade finishes with the banks it started with, as if nothing had been published
+    for (size_t frames = BLOCK; frames < CROSSFADE; frames += BLOCK) compare();
+    // Then only the latest update is applied, at the same block as a single update to the twin
+    TEST_ASSERT_TRUE(twin.get<dsp::Equalizer>().setBand(0, last));
+    for (int block = 0; block < 8; ++block) compare();
+}
+
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_shelf_boost_matches_float);
+    RUN_TEST(test_rejects_bands_that_do_not_fit);
+    RUN_TEST(test_headroom_absorbs_full_scale_boost);
+    RUN_TEST(test_chain_limits_boost_to_ceiling);
+    RUN_TEST(test_default_chain_is_transparent);
+    RUN_TEST(test_fused_matches_chained);
+    RUN_TEST(test_widening_pass_matches_separate_conversion);
+    RUN_TEST(test_changes_apply_at_the_next_block);
+    RUN_TEST(test_band_change_crossfades_continuously);
+    RUN_TEST(test_updates_during_crossfade_keep_busy_banks);
+    return UNITY_END();
+}
@@ -0,0 +1,178 @@
+#include <unity.h>
+#include <cmath>
+#include <cstdio>
+#include "PowerGovernor.hpp"
+
+/*
+ * The power policy table driven over a synthetic discharge: a 2000 mAh cell whose terminal voltage sags
+ * with the load the active policy draws, plus measurement noise and bass transients, sampled like the
+ * firmware's averaged battery reading. Run with -v to see the discharge timeline.
+ */
+
+constexpr float CAPACITY_MAH = 2000.0f;
+constexpr float RESISTANCE = 0.15f;    /* Cell and wiring, ohms */
+constexpr float CUTOFF = 3.30f;        /* Terminal voltage at which BatteryProtection shuts down */
+constexpr uint32_t STEP_SECONDS = 10;  /* Interval of the averaged battery reading */
+
+using Policy = PowerGovernor::Policy;
+
+
+void setUp() {}
+
+void tearDown() {}
+
+// Open circuit voltage, the inverse of PowerGovernor::stateOfCharge found by bisection
+static float openCircuit(float charge) {
+    float low = 3.0f, high = 4.3f;
+    for (int i = 0; i < 40; ++i) {
+        const auto middle = (low + high) / 2.0f;
+        (PowerGovernor::stateOfCharge(middle) < charge ? low : high) = middle;
+    }
+    return (low + high) / 2.0f;
+}
+
+/*
+ * Average current over one reading under a policy: Bluetooth and idle, the CPU, and the amplifier scaling
+ * with output power, doubled during passages with bass transients.
+ */
+static float currentMa(const Policy &policy, bool transient) {
+    const auto cpu = static_cast<float>(policy.cpuMhz) * 0.2f;
+    const auto power = policy.maxGain * policy.maxGain * policy.limiterCeiling;
+    return 60.0f + cpu + (policy.optionalDsp ? 5.0f : 0.0f) + power * (transient ? 600.0f : 300.0f);
+}
+
+struct Discharge {
+    uint32_t seconds = 0;     /* Runtime until the cutoff */
+    uint32_t changes = 0;     /* Policy changes */
+    uint32_t stepsUp = 0;     /* Changes towards a louder policy */
+    uint32_t entered[4]{};    /* Second each level was first entered */
+};
+
+/*
+ * Discharges the cell from full, feeding the governor every STEP_SECONDS. Without governing, the full power
+ * policy stays active throughout.
+ */
+static Discharge discharge(bool governed, bool print) {
+    PowerGovernor governor{};
+    Discharge result{};
+    uint32_t seed = 54;
+    auto charge = 1.0f;
+    while (true) {
+        const auto &policy = governed ? governor.policy() : PowerGovernor::POLICIES[0];
+        seed = seed * 1664525u + 1013904223u;
+        const auto transient = (seed >> 28) == 0;
+        const auto noise = (static_cast<float>(seed >> 8 & 0xFFFF) / 65535.0f - 0.5f) * 0.01f;
+        const auto current = currentMa(policy, transient);
+        const auto voltage = openCircuit(charge) - current / 1000.0f * RESISTANCE + noise;
+        if (voltage <= CUTOFF) break;
+        if (governed) {
+            const auto previous = governor.getLevel();
+            if (governor.update(voltage)) {
+                result.changes++;
+                if (governor.getLevel() < previous) result.stepsUp++;
+                if (!result.entered[governor.getLevel()]) result.entered[governor.getLevel()] = result.seconds;
+                if (print) {
+                    const auto &next = governor.policy();
+                    printf("{\"minutes\":%u,\"volts\":%.3f,\"charge\":%.3f,\"level\":%u,\"gain\":%.3f,"
+                           "\"ceiling\":%.3f,\"mhz\":%u}\n", result.seconds / 60, voltage, governor.getCharge(),
+                           static_cast<unsigned>(governor.getLevel()), next.maxGain, next.limiterCeiling,
+                           next.cpuMhz);
+                }
+            }
+        }
+        charge -= current * STEP_SECONDS / 3600.0f / CAPACITY_MAH;
+        result.seconds += STEP_SECONDS;
+    }
+    if (print) printf("{\"minutes\":%u,\"cutoff\":true,\"governed\":%s}\n", result.seconds / 60,
+                      governed ? "true" : "false");
+    return result;
+}
+
+static void test_state_of_charge_is_monotonic() {
+    TEST_ASSERT_EQUAL_FLOAT(0.0f, PowerGovernor::stateOfCharge(NAN));
+    TEST_ASSERT_EQUAL_FLOAT(0.0f, PowerGovernor::stateOfCharge(3.0f));
+    TEST_ASSERT_EQUAL_FLOAT(1.0f, PowerGovernor::stateOfCharge(4.25f));
+    auto previous = 0.0f;
+    for (auto voltage = 3.30f; voltage <= 4.20f; voltage += 0.001f) {
+        const auto charge = PowerGovernor::stateOfCharge(voltage);
+        TEST_ASSERT_TRUE(charge >= previous);
+        previous = charge;
+    }
+}
+
+static void test_policies_only_get_more_frugal() {
+    const auto &policies = PowerGovernor::POLICIES;
+    constexpr auto n = sizeof(policies) / sizeof(policies[0]);
+    TEST_ASSERT_EQUAL_FLOAT(0.0f, policies[n - 1].minCharge);
+    for (size_t i = 0; i < n; ++i) {
+        TEST_ASSERT_TRUE(policies[i].cpuMhz >= 80);
+        TEST_ASSERT_TRUE(policies[i].maxGain <= 1.0f && policies[i].limiterCeiling <= 1.0f);
+        if (i == 0) continue;
+        TEST_ASSERT_TRUE(policies[i].minCharge + PowerGovernor::HYSTERESIS < policies[i - 1].minCharge);
+        TEST_ASSERT_TRUE(policies[i].maxGain <= policies[i - 1].maxGain);
+        TEST_ASSERT_TRUE(policies[i].limiterCeiling <= policies[i - 1].limiterCeiling);
+        TEST_ASSERT_TRUE(policies[i].cpuMhz <= policies[i - 1].cpuMhz);
+        TEST_ASSERT_TRUE(!policies[i].optionalDsp || policies[i - 1].optionalDsp);
+    }
+}
+
+static void test_discharge_steps_down_without_chatter() {
+    const auto governed = discharge(true, true);
+    // Every level is reached in order, once, despite noise, transients and the voltage recovering as the
+    // quieter policies draw less current
+    TEST_ASSERT_EQUAL(3, governed.changes);
+    TEST_ASSERT_EQUAL(0, governed.stepsUp);
+    TEST_ASSERT_TRUE(governed.entered[1] > 0);
+    TEST_ASSERT_TRUE(governed.entered[2] > governed.entered[1]);
+    TEST_ASSERT_TRUE(governed.entered[3] > governed.entered[2]);
+}
+
+static void test_governing_extends_runtime() {
+    const auto governed = discharge(true, false);
+    const auto ungoverned = discharge(false, true);
+    printf("{\"runtime_governed_min\":%u,\"runtime_full_power_min\":%u}\n", governed.seconds / 60,
+           ungoverned.seconds / 60);
+    TEST_ASSERT_TRUE(governed.seconds > ungoverned.seconds + ungoverned.seconds / 10);
+}
+
+// Feeds the same reading until the smoothed charge has settled, returns whether the policy changed
+static bool settle(PowerGovernor &governor, float charge) {
+    bool changed = false;
+    for (int i = 0; i < 200; ++i) changed |= governor.update(openCircuit(charge));
+    return changed;
+}
+
+static void test_recovers_only_past_hysteresis() {
+    PowerGovernor governor{};
+    const auto boundary = PowerGovernor::POLICIES[0].minCharge;
+    TEST_ASSERT_TRUE(settle(governor, boundary - 0.01f));
+    TEST_ASSERT_EQUAL(1, governor.getLevel());
+    TEST_ASSERT_FALSE(settle(governor, boundary + PowerGovernor::HYSTERESIS / 2.0f));
+    TEST_ASSERT_FALSE(governor.update(NAN));
+    TEST_ASSERT_EQUAL(1, governor.getLevel());
+    TEST_ASSERT_TRUE(settle(governor, boundary + PowerGovernor::HYSTERESIS + 0.01f));
+    TEST_ASSERT_EQUAL(0, governor.getLevel());
+}
+
+static void test_single_sag_does_not_switch() {
+    PowerGovernor governor{};
+    TEST_ASSERT_FALSE(settle(governor, 0.6f));
+    TEST_ASSERT_FALSE(governor.update(openCircuit(0.4f)));
+    TEST_ASSERT_FALSE(governor.update(openCircuit(0.6f)));
+    TEST_ASSERT_EQUAL(0, governor.getLevel());
+    // The first reading is taken as is, booting on a low battery applies the matching policy right away
+    PowerGovernor low{};
+    TEST_ASSERT_TRUE(low.update(openCircuit(0.05f)));
+    TEST_ASSERT_EQUAL(3, low.getLevel());
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_state_of_charge_is_monotonic);
+    RUN_TEST(test_policies_only_get_more_frugal);
+    RUN_TEST(test_discharge_steps_down_without_chatter);
+    RUN_TEST(test_governing_extends_runtime);
+    RUN_TEST(test_recovers_only_past_hysteresis);
+    RUN_TEST(test_single_sag_does_not_switch);
+    return UNITY_END();
+}
@@ -0,0 +1,470 @@
+#include <unity.h>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <queue>
+#include <vector>
+#include "App.hpp"
+#include "Oscillator.hpp"
+
+/*
+ * Whole-device simulation on virtual time. Device runs the firmware's App from include/App.hpp, the same glue
+ * src/main.cpp runs, against the mocks in test/stubs: buttons and the amplifier pin on mocked GPIO, the
+ * battery ADC fed by a cell model, the I2S output paced at the sample rate, and a Bluetooth source that
+ * connects, streams PCM in A2DP-sized chunks through the simulated sink and reports the link RSSI. Events
+ * run in time order and the clock jumps from one to the next, so hours of use take seconds. Only the
+ * Bluetooth stack, Wi-Fi and OTA edges are simulated. Run with -v to see the firmware's log on virtual time.
+ */
+
+constexpr uint8_t AMP_SD = 2;
+constexpr uint8_t BAT_VOLT = 36;
+constexpr uint8_t BUT_LEFT = 26;
+constexpr uint8_t BUT_RIGHT = 25;
+constexpr uint8_t BUT_CENTER = 27;
+constexpr float BAT_DIVIDER = 6.9f / (22.0f + 6.9f);
+constexpr esp_bd_addr_t PHONE = {0x02, 0x11, 0x22, 0x33, 0x44, 0x55};
+
+constexpr uint64_t MS = 1000;
+constexpr uint64_t SECOND = 1000 * MS;
+constexpr uint64_t LOOP_MICROS = MS;  /* Loop period, the firmware's loop spins at least this fast */
+constexpr uint64_t MONITOR_MICROS = 100 * MS;  /* Period of the health monitor task */
+constexpr uint32_t RATE = 44100;
+constexpr size_t CHUNK_FRAMES = 512;  /* Frames per write from the sink */
+
+
+void setUp() {
+    mock::reset();
+    mock::i2s::reset();
+    Preferences::erase();
+}
+
+void tearDown() {}
+
+// Discrete-event scheduler on the mocked clock, events at the same time run in the order they were added
+class Simulation {
+public:
+    using Event = std::function<void()>;
+
+    void at(uint64_t micros, Event event) { queue.push({micros, sequence++, std::move(event)}); }
+
+    void after(uint64_t micros, Event event) { at(mock::elapsed + micros, std::move(event)); }
+
+    // Runs the event every period until it returns false
+    void every(uint64_t period, std::function<bool()> event) {
+        after(period, [this, period, event = std::move(event)]() mutable {
+            if (event()) every(period, std::move(event));
+        });
+    }
+
+    // Runs all events up to the time unless stopped, events may advance the clock themselves by blocking
+    void runUntil(uint64_t end) {
+        while (!stopped && !queue.empty() && queue.top().time <= end) {
+            auto entry = std::move(const_cast<Entry &>(queue.top()));
+            queue.pop();
+            mock::advanceTo(entry.time);
+            entry.event();
+            events++;
+        }
+        if (!stopped) mock::advanceTo(end);
+    }
+
+    void stop() { stopped = true; }
+
+    uint64_t events = 0;
+
+private:
+    struct Entry {
+        uint64_t time;
+        uint64_t sequence;
+        Event event;
+
+        bool operator>(const Entry &other) const {
+            return time != other.time ? time > other.time : sequence > other.sequence;
+        }
+    };
+
+    std::priority_queue<Entry, std::vector<Entry>, std::greater<>> queue;
+    uint64_t sequence = 0;
+    bool stopped = false;
+};
+
+/*
+ * The Bluetooth edge of the App: records what the App asks of the sink and passes the PCM Source writes on
+ * to the stream it was constructed with, like the A2DP sink does.
+ */
+struct SimulatedSink {
+    explicit SimulatedSink(audio_tools::AudioStream &out) : out(out) {}
+
+    void set_discoverability(esp_bt_discovery_mode_t mode) { discoverable = mode != ESP_BT_NON_DISCOVERABLE; }
+
+    void set_connectable(bool value) { connectable = value; }
+
+    int get_volume() { return volume; }
+
+    void set_volume(uint8_t value) { volume = value; }
+
+    void next() { track++; }
+
+    void previous() { track--; }
+
+    void play() { playStatus(ESP_AVRC_PLAYBACK_PLAYING); }
+
+    void pause() { playStatus(ESP_AVRC_PLAYBACK_PAUSED); }
+
+    bool is_connected() { return connected; }
+
+    void disconnect() { disconnects++; }
+
+    void connect_to(esp_bd_addr_t) { pages++; }
+
+    esp_bd_addr_t *get_current_peer_address() { return connected ? &peer : nullptr; }
+
+    void set_i2s_ringbuffer_prefetch_percent(int value) { prefetchPercent = value; }
+
+    void end() { ended = true; }
+
+    audio_tools::AudioStream &out;
+    std::function<void(esp_avrc_playback_stat_t)> playStatus;  /* The phone's answer to play and pause */
+    esp_bd_addr_t peer{};
+    bool connected = false;
+    bool connectable = false;
+    bool discoverable = false;
+    bool ended = false;
+    int volume = 0;
+    int track = 0;
+    int prefetchPercent = 0;
+    uint32_t disconnects = 0;
+    uint32_t pages = 0;
+};
+
+struct SimulatedNetwork {
+    void begin(const char *, const char *) {}
+
+    bool connected() { return up; }
+
+    bool up = false;
+};
+
+// Downloads for downloadMicros in steps of the health monitor's period, the monitor task keeps running
+struct SimulatedFirmware {
+    bool pull(const char *) {
+        for (uint64_t time = 0; time < downloadMicros; time += MONITOR_MICROS) {
+            delay(MONITOR_MICROS / MS);
+            if (monitor) monitor->check(Clock::millis());
+        }
+        return installs;
+    }
+
+    void confirm(uint32_t, uint32_t) {}
+
+    HealthMonitor *monitor = nullptr;
+    uint64_t downloadMicros = 0;
+    bool installs = true;
+};
+
+// The speaker, set up like src/main.cpp around the App, observing what the App does each loop
+struct Device {
+    audio_tools::AudioStream out{};
+    App<SimulatedSink, SimulatedNetwork, SimulatedFirmware> app{out, {AMP_SD, BAT_VOLT, BAT_DIVIDER, BUT_LEFT,
+                                                                       BUT_RIGHT, BUT_CENTER}};
+    uint32_t policyChanges = 0;
+    uint32_t policyStepsUp = 0;
+    uint32_t warnings = 0;
+    uint32_t cutoffAt = 0;
+    uint32_t shutdownAt = 0;
+    uint8_t level = 0;
+    BatteryProtection::State protection = BatteryProtection::State::NORMAL;
+
+    // A paired device remembers the phone, an unpaired one starts in the pairing mode
+    void setup(bool paired) {
+        if (paired) PeerList{}.remember(PHONE);
+        app.setup();
+        TEST_ASSERT_TRUE(app.blocks.stats().available == app.PCM_BLOCKS);
+        app.sink.playStatus = [this](esp_avrc_playback_stat_t status) { app.meta.onPlayStatus(status); };
+        app.start();
+        level = app.governor.getLevel();
+    }
+
+    void loop() {
+        app.loop();
+        if (app.governor.getLevel() != level) {
+            policyChanges++;
+            if (app.governor.getLevel() < level) policyStepsUp++;
+            level = app.governor.getLevel();
+        }
+        const auto state = app.protection.getState();
+        if (state != protection) {
+            if (state == BatteryProtection::State::WARNING) warnings++;
+            if (state == BatteryProtection::State::CUTOFF) cutoffAt = Clock::millis();
+            protection = state;
+        }
+        if (mock::deepSleepAt) shutdownAt = static_cast<uint32_t>(mock::deepSleepAt / MS);
+    }
+
+    // Starts the loop and the health monitor, both stop with the deep sleep
+    void boot(Simulation &simulation, bool paired) {
+        setup(paired);
+        app.firmware.monitor = &app.health;
+        simulation.every(LOOP_MICROS, [this, &simulation] {
+            loop();
+            if (shutdownAt) simulation.stop();
+            return !shutdownAt;
+        });
+        simulation.every(MONITOR_MICROS, [this] {
+            app.health.check(Clock::millis());
+            return !shutdownAt;
+        });
+    }
+
+    uint32_t violations() const {
+        return app.health.getEntry(app.loopHealth).violations + app.health.getEntry(app.audioHealth).violations;
+    }
+};
+
+// Phone streaming a tone through the mocked Bluetooth sink
+struct Source {
+    Device &device;
+    Simulation &simulation;
+    dsp::Oscillator oscillator{};
+    int16_t chunk[CHUNK_FRAMES * 2]{};
+    int8_t rssi = -2;
+
+    void connect() {
+        auto &sink = device.app.sink;
+        memcpy(sink.peer, PHONE, sizeof(PHONE));
+        sink.connected = true;
+        sink.out.setAudioInfo({static_cast<int>(RATE), 2, 16});
+        device.app.onConnectionState(ESP_A2D_CONNECTION_STATE_CONNECTED);
+    }
+
+    void disconnect() {
+        device.app.sink.connected = false;
+        device.app.onConnectionState(ESP_A2D_CONNECTION_STATE_DISCONNECTED);
+    }
+
+    // Streams from now for the duration, pausing for stallMicros before each chunk the predicate selects
+    void stream(uint64_t duration, std::function<bool(uint64_t)> stall = nullptr, uint64_t stallMicros = 0) {
+        oscillator.setFrequency(1000.0f, RATE);
+        const auto period = CHUNK_FRAMES * SECOND / RATE;
+        auto next = mock::elapsed;
+        for (uint64_t time = 0; time < duration; time += period) {
+            if (stall && stall(time)) next += stallMicros;
+            simulation.at(next, [this] { write(); });
+            next += period;
+        }
+        simulation.every(SECOND, [this, end = mock::elapsed + duration] {
+            device.app.linkMonitor.onRssi(rssi);
+            return mock::elapsed < end;
+        });
+    }
+
+    void write() {
+        for (size_t i = 0; i < CHUNK_FRAMES; ++i) chunk[2 * i] = chunk[2 * i + 1] = oscillator.next() / 2;
+        device.app.sink.out.write(reinterpret_cast<const uint8_t *>(chunk), sizeof(chunk));
+    }
+};
+
+// Holds the button's pin low for the duration, bouncing for bounceMillis at both edges
+static void press(Simulation &simulation, uint8_t pin, uint64_t at, uint64_t millis, uint64_t bounceMillis = 3) {
+    for (uint64_t i = 0; i <= bounceMillis; ++i) {
+        const uint8_t level = (bounceMillis - i) % 2 ? HIGH : LOW;
+        simulation.at(at + i * MS, [pin, level] { mock::setLevel(pin, level); });
+        simulation.at(at + (millis + i) * MS, [pin, level] { mock::setLevel(pin, level == LOW ? HIGH : LOW); });
+    }
+}
+
+// Open circuit voltage, the inverse of PowerGovernor::stateOfCharge found by bisection
+static float openCircuit(float charge) {
+    float low = 3.0f, high = 4.3f;
+    for (int i = 0; i < 40; ++i) {
+        const auto middle = (low + high) / 2.0f;
+        (PowerGovernor::stateOfCharge(middle) < charge ? low : high) = middle;
+    }
+    return (low + high) / 2.0f;
+}
+
+/*
+ * Cell discharged by the device's draw, updated every second: the CPU at the mocked frequency, the amplifier
+ * while its shutdown pin is high and the output power written to I2S. The battery ADC reads the terminal
+ * voltage through the divider with a few LSB of noise.
+ */
+struct Cell {
+    float capacityMah;
+    float resistance = 0.15f;
+    float charge = 1.0f;
+    uint32_t seed = 70;
+
+    float currentMa() const {
+        const auto &port = mock::i2s::ports[I2S_NUM_0];
+        const auto level = static_cast<float>(port.peak) / 32768.0f;
+        const auto amp = mock::pins[AMP_SD].level == HIGH ? 5.0f + 400.0f * level * level : 0.0f;
+        return 60.0f + static_cast<float>(mock::cpuMhz) * 0.2f + amp;
+    }
+
+    void update() {
+        const auto current = currentMa();
+        mock::i2s::ports[I2S_NUM_0].peak = 0;
+        charge = std::max(0.0f, charge - current / 3600.0f / capacityMah);
+        seed = seed * 1664525u + 1013904223u;
+        const auto noise = static_cast<float>(static_cast<int>(seed >> 29) - 4);
+        const auto volts = openCircuit(charge) - current / 1000.0f * resistance;
+        const auto raw = volts * BAT_DIVIDER * 1000.0f / 1100.0f * 4095.0f + noise;
+        mock::setAdc(BAT_VOLT, static_cast<uint16_t>(std::clamp(raw, 0.0f, 4095.0f)));
+    }
+
+    void attach(Simulation &simulation) {
+        update();
+        simulation.every(SECOND, [this] {
+            update();
+            return true;
+        });
+    }
+};
+
+static void report(const char *name, const Simulation &simulation, std::chrono::steady_clock::time_point start) {
+    const auto wall = std::chrono::steady_clock::now() - start;
+    printf("{\"name\":\"%s\",\"simulated_s\":%.1f,\"wall_ms\":%.1f,\"events\":%llu}\n", name,
+           static_cast<double>(mock::elapsed) / 1e6,
+           std::chrono::duration<double, std::milli>(wall).count(),
+           static_cast<unsigned long long>(simulation.events));
+}
+
+static void test_streaming_session() {
+    const auto start = std::chrono::steady_clock::now();
+    Simulation simulation{};
+    const auto device = std::make_unique<Device>();
+    Cell cell{2000.0f};
+    cell.attach(simulation);
+    device->boot(simulation, true);
+    Source source{*device, simulation};
+    // 20 s of a tone from 1 s, with three 30 ms stalls around 6 s and the amplifier gated 3 s after the end
+    simulation.at(1 * SECOND, [&] {
+        source.connect();
+        source.stream(20 * SECOND, [](uint64_t time) {
+            return time >= 5 * SECOND && time < 5 * SECOND + 3 * CHUNK_FRAMES * SECOND / RATE;
+        }, 30 * MS);
+    });
+    simulation.runUntil(10 * SECOND);
+    TEST_ASSERT_EQUAL(HIGH, mock::pins[AMP_SD].level);
+    TEST_ASSERT_EQUAL(2, device->app.linkMonitor.getLevel());
+    simulation.runUntil(30 * SECOND);
+    report("streaming_session", simulation, start);
+
+    const auto &metrics = device->app.processed.getMetrics();
+    const auto &port = mock::i2s::ports[I2S_NUM_0];
+    TEST_ASSERT_EQUAL(PairingController::State::CONNECTED, device->app.pairing.getState());
+    TEST_ASSERT_EQUAL_UINT32(0, metrics.dropped);
+    TEST_ASSERT_EQUAL_UINT32(3, metrics.late);
+    TEST_ASSERT_TRUE(port.audibleFrames >= 20 * RATE - CHUNK_FRAMES && port.audibleFrames <= 20 * RATE + 512);
+    // A late window deepens the jitter buffer, three clean windows make it shallower again
+    TEST_ASSERT_EQUAL_UINT32(2, device->app.linkMonitor.getMetrics().changes);
+    TEST_ASSERT_EQUAL(1, device->app.linkMonitor.getLevel());
+    TEST_ASSERT_EQUAL(device->app.linkMonitor.depth().prefetchPercent, device->app.sink.prefetchPercent);
+    TEST_ASSERT_EQUAL(LOW, mock::pins[AMP_SD].level);
+    TEST_ASSERT_UINT32_WITHIN(150, 6000, device->app.amp.gatedMillis(Clock::millis()));
+    TEST_ASSERT_TRUE(metrics.nsPerSample > 0.0f);
+    TEST_ASSERT_EQUAL_UINT32(0, device->violations());
+}
+
+static void test_pairing_and_buttons() {
+    Simulation simulation{};
+    const auto device = std::make_unique<Device>();
+    Cell cell{2000.0f};
+    cell.attach(simulation);
+    device->boot(simulation, false);
+    TEST_ASSERT_TRUE(device->app.sink.discoverable);
+    simulation.runUntil(121 * SECOND);
+    TEST_ASSERT_EQUAL(PairingController::State::IDLE, device->app.pairing.getState());
+    TEST_ASSERT_EQUAL_UINT32(1, device->app.pairing.getMetrics().timeouts);
+    TEST_ASSERT_FALSE(device->app.sink.discoverable);
+    TEST_ASSERT_TRUE(device->app.sink.connectable);
+
+    // Holding the center button past the long press starts pairing, a phone connects 5 s later
+    press(simulation, BUT_CENTER, 130 * SECOND, 400);
+    Source source{*device, simulation};
+    simulation.at(135 * SECOND, [&] { source.connect(); });
+    simulation.runUntil(136 * SECOND);
+    TEST_ASSERT_EQUAL(PairingController::State::CONNECTED, device->app.pairing.getState());
+    TEST_ASSERT_EQUAL_UINT32(1, device->app.pairing.getMetrics().pairings);
+    TEST_ASSERT_UINT32_WITHIN(5, 5000 - 330 - 5, device->app.pairing.getMetrics().lastPairingMillis);
+    TEST_ASSERT_EQUAL(ESP_AVRC_PLAYBACK_STOPPED, device->app.meta.playing);
+
+    // Short presses step the volume, a long press skips back, the center button toggles playback
+    press(simulation, BUT_RIGHT, 140 * SECOND, 80);
+    press(simulation, BUT_RIGHT, 141 * SECOND, 80);
+    press(simulation, BUT_LEFT, 142 * SECOND, 600);
+    press(simulation, BUT_CENTER, 143 * SECOND, 50);
+    simulation.runUntil(145 * SECOND);
+    TEST_ASSERT_EQUAL(Settings{}.volume + 8, device->app.meta.volume);
+    TEST_ASSERT_EQUAL(Settings{}.volume + 8, device->app.sink.volume);
+    TEST_ASSERT_EQUAL(-1, device->app.sink.track);
+    TEST_ASSERT_EQUAL(ESP_AVRC_PLAYBACK_PLAYING, device->app.meta.playing);
+    source.disconnect();
+    simulation.runUntil(146 * SECOND);
+    TEST_ASSERT_EQUAL(PairingController::State::IDLE, device->app.pairing.getState());
+}
+
+static void test_discharge_to_shutdown() {
+    const auto start = std::chrono::steady_clock::now();
+    Simulation simulation{};
+    const auto device = std::make_unique<Device>();
+    Cell cell{150.0f};
+    cell.attach(simulation);
+    device->boot(simulation, true);
+    simulation.runUntil(24 * 3600 * SECOND);
+    report("discharge_to_shutdown", simulation, start);
+
+    // Every power level is stepped down to once, the warning cue plays, then the cutoff and deep sleep
+    TEST_ASSERT_EQUAL_UINT32(3, device->policyChanges);
+    TEST_ASSERT_EQUAL_UINT32(0, device->policyStepsUp);
+    TEST_ASSERT_EQUAL_UINT32(1, device->warnings);
+    TEST_ASSERT_TRUE(device->cutoffAt > 3600 * 1000);
+    TEST_ASSERT_UINT32_WITHIN(LOOP_MICROS / MS + 1, 2000, device->shutdownAt - device->cutoffAt);
+    TEST_ASSERT_EQUAL(BatteryProtection::State::CUTOFF, device->app.protection.getState());
+    TEST_ASSERT_TRUE(device->app.sink.ended);
+    TEST_ASSERT_EQUAL(LOW, mock::pins[AMP_SD].level);
+    TEST_ASSERT_EQUAL_UINT32(80, mock::cpuMhz);
+    // Both cues reached the speaker, waking the gated amplifier each time
+    const auto &port = mock::i2s::ports[I2S_NUM_0];
+    TEST_ASSERT_TRUE(port.audibleFrames > RATE * 2 / 3);
+    TEST_ASSERT_FALSE(device->app.processed.playing());
+    TEST_ASSERT_EQUAL_UINT32(6, mock::pins[AMP_SD].writes);
+}
+
+static void test_update_while_streaming() {
+    Simulation simulation{};
+    const auto device = std::make_unique<Device>();
+    Cell cell{2000.0f};
+    cell.attach(simulation);
+    device->boot(simulation, true);
+    Source source{*device, simulation};
+    simulation.at(1 * SECOND, [&] {
+        source.connect();
+        source.stream(20 * SECOND);
+    });
+    // The update command arrives mid-stream, the download takes three minutes
+    device->app.network.up = true;
+    device->app.firmware.downloadMicros = 180 * SECOND;
+    simulation.at(5 * SECOND, [&] {
+        device->app.update("speaker", "secret", "http://192.168.1.2/firmware.ota");
+        simulation.stop();
+    });
+    simulation.runUntil(10 * SECOND);
+
+    TEST_ASSERT_EQUAL_UINT32(1, mock::restarts);
+    TEST_ASSERT_TRUE(device->app.sink.ended);
+    TEST_ASSERT_TRUE(mock::elapsed >= 185 * SECOND);
+    // Neither the stopped loop nor the stopped audio path counts as a missed deadline, nor is recovered
+    TEST_ASSERT_EQUAL_UINT32(0, device->violations());
+    TEST_ASSERT_EQUAL_UINT32(0, mock::i2s::ports[I2S_NUM_0].stops);
+}
+
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_streaming_session);
+    RUN_TEST(test_pairing_and_buttons);
+    RUN_TEST(test_discharge_to_shutdown);
+    RUN_TEST(test_update_while_streaming);
+    return UNITY_END();
+}